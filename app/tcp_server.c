@@ -1,9 +1,13 @@
 #include "driver.h"
 #include "net.h"
 
+#include <signal.h>
+
 #ifdef TCP
 #include "tcp.h"
 void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    if (!data)  // 发送缓冲区有了空间或连接已关闭的通知，回显的数据都已放入缓冲区
+        return;
     for (int i = 0; i < len; i++)
         putchar(data[i]);
     if (len)
@@ -14,6 +18,12 @@ void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_i
 }
 #endif
 
+static volatile sig_atomic_t running = 1;
+
+void stop_handler(int sig) {
+    running = 0;
+}
+
 int main(int argc, char const *argv[]) {
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
@@ -24,9 +34,12 @@ int main(int argc, char const *argv[]) {
     tcp_open(60000, tcp_handler);  // 注册端口的tcp监听回调
 #endif
 
-    while (1) {
+    signal(SIGINT, stop_handler);  // 收到信号后退出主循环，正常关闭协议栈
+    signal(SIGTERM, stop_handler);
+    while (running) {
         net_poll();  // 一次主循环
     }
 
+    net_close();
     return 0;
 }
@@ -1,6 +1,8 @@
 #include "driver.h"
 #include "net.h"
 
+#include <signal.h>
+
 #ifdef UDP
 #include "udp.h"
 void udp_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
@@ -12,6 +14,12 @@ void udp_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port)
 }
 #endif
 
+static volatile sig_atomic_t running = 1;
+
+void stop_handler(int sig) {
+    running = 0;
+}
+
 int main(int argc, char const *argv[]) {
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
@@ -22,9 +30,12 @@ int main(int argc, char const *argv[]) {
     udp_open(60000, udp_handler);  // 注册端口的udp监听回调
 #endif
 
-    while (1) {
+    signal(SIGINT, stop_handler);  // 收到信号后退出主循环，正常关闭协议栈
+    signal(SIGTERM, stop_handler);
+    while (running) {
         net_poll();  // 一次主循环
     }
 
+    net_close();
     return 0;
 }
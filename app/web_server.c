@@ -1,10 +1,34 @@
 #include "driver.h"
+#include "map.h"
 #include "net.h"
 #include "tcp.h"
 
+#include <signal.h>
+
 #define HTTP_MAX_PATH_LENGTH 1024
 #define HTTP_MAX_RESPONSE_LENGTH 1024
 #define HTTP_LISTEN_PORT 80
+#define HTTP_PENDING_TIMEOUT_SEC 60  // 未发完的响应在这么久没有进展后丢弃
+
+typedef struct http_key  // 一个 HTTP 连接的键：对端 IP 和端口
+{
+    uint8_t ip[NET_IP_LEN];
+    uint16_t port;
+} http_key_t;
+
+typedef struct http_pending  // 发送缓冲区满时尚未交给 tcp_send 的响应，收到 ACK 腾出空间后继续发送
+{
+    char head[HTTP_MAX_RESPONSE_LENGTH];   // 响应头（404 时含响应体）
+    size_t head_len;                       // 响应头的长度
+    size_t head_off;                       // 响应头已发送的字节数
+    char file_path[HTTP_MAX_PATH_LENGTH];  // 响应体所在的文件，空串表示没有
+    long file_off;                         // 文件已发送的字节数
+    char next_path[HTTP_MAX_PATH_LENGTH];  // 发送期间收到的下一个请求的 URL，本响应发完后再响应，空串表示没有
+} http_pending_t;
+
+static map_t http_pending_table;  // [src_ip, src_port] -> http_pending
+
+void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *dst_ip, uint16_t dst_port);
 
 /**
  * @brief 根据文件路径返回对应的 MIME 类型
@@ -27,6 +51,63 @@ static inline const char *http_get_mime_type(const char *file_path) {
     return "application/octet-stream";  // 默认类型
 }
 
+/**
+ * @brief 发送响应中尚未交给 tcp_send 的部分
+ *        tcp_send 放不下全部数据时记下进度，tcp 层收到 ACK 腾出空间后通知应用，再从这里继续；
+ *        发完则删除记录，再响应期间收到的下一个请求
+ *
+ * @param tcp_conn  指向当前 TCP 连接的指针
+ * @param pending   响应的发送进度
+ * @param port      本连接端口
+ * @param dst_ip    目标 IP 地址
+ * @param dst_port  目标端口
+ */
+static void http_send_pending(tcp_conn_t *tcp_conn, http_pending_t *pending, uint16_t port, uint8_t *dst_ip, uint16_t dst_port) {
+    http_key_t key = {.port = dst_port};
+    memcpy(key.ip, dst_ip, NET_IP_LEN);
+    FILE *file = NULL;
+    int len;
+
+    // 发送响应头的剩余部分
+    if (pending->head_off < pending->head_len) {
+        len = tcp_send(tcp_conn, (uint8_t *)pending->head + pending->head_off, pending->head_len - pending->head_off, port, dst_ip, dst_port);
+        if (len < 0)
+            goto done;
+        pending->head_off += len;
+        if (pending->head_off < pending->head_len)
+            goto blocked;
+    }
+    if (!pending->file_path[0])
+        goto done;
+
+    // 从上次停下的位置继续发送文件
+    file = fopen(pending->file_path, "rb");
+    if (!file || fseek(file, pending->file_off, SEEK_SET))
+        goto done;
+    char resp_buffer[HTTP_MAX_RESPONSE_LENGTH];
+    size_t bytes_read;
+    while ((bytes_read = fread(resp_buffer, 1, sizeof(resp_buffer), file)) > 0) {
+        len = tcp_send(tcp_conn, (uint8_t *)resp_buffer, bytes_read, port, dst_ip, dst_port);
+        if (len < 0)
+            goto done;
+        pending->file_off += len;
+        if (len < bytes_read)  // 发送缓冲区已满
+            goto blocked;
+    }
+
+done:
+    map_delete(&http_pending_table, &key);
+    if (file)
+        fclose(file);
+    if (pending->next_path[0])
+        http_respond(tcp_conn, pending->next_path, port, dst_ip, dst_port);
+    return;
+blocked:
+    map_set(&http_pending_table, &key, pending);  // 同时刷新超时时间
+    if (file)
+        fclose(file);
+}
+
 /**
  * @brief 响应函数
  *
@@ -38,7 +119,9 @@ static inline const char *http_get_mime_type(const char *file_path) {
  */
 void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *dst_ip, uint16_t dst_port) {
     FILE *file;
-    char file_path[HTTP_MAX_PATH_LENGTH];
+    http_pending_t pending = {0};
+    char *file_path = pending.file_path;
+    char *resp_buffer = pending.head;
     memcpy(file_path, HTTP_RESOURCE_DIR, sizeof(HTTP_RESOURCE_DIR));
 
     // 获取文件路径，打开文件
@@ -50,8 +133,6 @@ void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *
     // 打开文件
     file = fopen(file_path, "rb");
 
-    char resp_buffer[HTTP_MAX_RESPONSE_LENGTH] = {0};
-
     // 文件不存在时发送 404 响应
     if (!file) {
         // HTTP 404 响应请求体
@@ -59,72 +140,57 @@ void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *
                                "The resource specified\r\n"
                                "is unavailable or nonexistent.\r\n"
                                "</BODY></HTML>\r\n";
-        /* Step1 ：发送 HTTP 404 请求头 */
-        // TODO: 发送 HTTP 状态行
-        sprintf(resp_buffer, "HTTP/1.1 404 NOT FOUND\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-        // 发送 HTTP 连接信息
-        sprintf(resp_buffer, "Connection: Keep-Alive\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-        // TODO: 发送 HTTP 内容类型
-        sprintf(resp_buffer, "Content-Type: text/html\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-
-        // TODO: 发送 HTTP 内容长度
-        sprintf(resp_buffer, "Content-Length: %d\r\n", strlen(not_found_body));
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-        // TODO: 发送 HTTP 响应头与响应体的分隔符
-        sprintf(resp_buffer, "\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-        // TODO: 发送 HTTP 响应体
-        tcp_send(tcp_conn, (uint8_t *)not_found_body, strlen(not_found_body), port, dst_ip, dst_port);
-
+        /* Step1 ：生成 HTTP 404 响应头与响应体 */
+        pending.head_len = snprintf(resp_buffer, HTTP_MAX_RESPONSE_LENGTH,
+                                    "HTTP/1.1 404 NOT FOUND\r\n"      // HTTP 状态行
+                                    "Connection: Keep-Alive\r\n"      // HTTP 连接信息
+                                    "Content-Type: text/html\r\n"     // HTTP 内容类型
+                                    "Content-Length: %zu\r\n"         // HTTP 内容长度
+                                    "\r\n"                            // 响应头与响应体的分隔符
+                                    "%s",                             // HTTP 响应体
+                                    strlen(not_found_body), not_found_body);
+        file_path[0] = '\0';
+        http_send_pending(tcp_conn, &pending, port, dst_ip, dst_port);
         return;
     }
 
-    /* Step2 ：发送 HTTP 请求头 */
-    // TODO: 发送 HTTP 状态行
-    sprintf(resp_buffer, "HTTP/1.1 200 OK\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-    // 发送 HTTP 连接信息
-    sprintf(resp_buffer, "Connection: Keep-Alive\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-    const char *content_type = http_get_mime_type(file_path);
-    // TODO: 发送 HTTP 内容类型，根据文件类型设置 MIME 类型
-    sprintf(resp_buffer, "Content-Type: %s\r\n", content_type);
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-
+    /* Step2 ：生成 HTTP 响应头 */
     fseek(file, 0, SEEK_END);
     size_t content_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    // TODO: 发送 HTTP 内容长度
-    sprintf(resp_buffer, "Content-Length: %d\r\n", content_length);
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-    // TODO: 发送 HTTP 响应头与响应体的分隔符
-    sprintf(resp_buffer, "\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen(resp_buffer), port, dst_ip, dst_port);
-
-    /* Step3 ：发送 HTTP 响应体 */
-    size_t bytes_read;
-    while ((bytes_read = fread(resp_buffer, 1, sizeof(resp_buffer), file)) > 0) {
-        // TODO: 每次发送读取的文件内容块
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, bytes_read, port, dst_ip, dst_port);
-    }
-
-    // 后处理: 关闭文件
     fclose(file);
+    pending.head_len = snprintf(resp_buffer, HTTP_MAX_RESPONSE_LENGTH,
+                                "HTTP/1.1 200 OK\r\n"          // HTTP 状态行
+                                "Connection: Keep-Alive\r\n"   // HTTP 连接信息
+                                "Content-Type: %s\r\n"         // HTTP 内容类型，根据文件类型设置 MIME 类型
+                                "Content-Length: %zu\r\n"      // HTTP 内容长度
+                                "\r\n",                        // 响应头与响应体的分隔符
+                                http_get_mime_type(file_path), content_length);
+
+    /* Step3 ：发送响应头与响应体，发送缓冲区满时等收到 ACK 再继续 */
+    http_send_pending(tcp_conn, &pending, port, dst_ip, dst_port);
 }
 
 void http_request_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
     char method[4];
     char url_path[HTTP_MAX_PATH_LENGTH];
+    http_key_t key = {.port = src_port};
+    memcpy(key.ip, src_ip, NET_IP_LEN);
+    http_pending_t *pending = map_get(&http_pending_table, &key);
+
+    // 连接已关闭或被重置，丢弃未发完的响应
+    if (!tcp_conn) {
+        map_delete(&http_pending_table, &key);
+        return;
+    }
+
+    // 发送缓冲区有了空间，继续发送未发完的响应
+    if (!data) {
+        if (pending) {
+            http_pending_t copy = *pending;  // http_send_pending 会覆盖或删除表中的记录
+            http_send_pending(tcp_conn, &copy, HTTP_LISTEN_PORT, src_ip, src_port);
+        }
+        return;
+    }
 
     // 提取 HTTP 方法。目前仅支持 "GET" 请求
     if (sscanf((char *)data, "%3s", method) != 1 || strcmp(method, "GET") != 0)
@@ -141,21 +207,38 @@ void http_request_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8
     }
     url_path[j] = '\0';
 
+    // 上一个响应还没发完，新的响应不能插在中间：记下请求，等它发完再响应。同时只记一个，更多的请求忽略
+    if (pending) {
+        if (!pending->next_path[0])
+            strcpy(pending->next_path, url_path);
+        return;
+    }
+
     // 发送响应
     http_respond(tcp_conn, url_path, HTTP_LISTEN_PORT, src_ip, src_port);
 }
 
+static volatile sig_atomic_t running = 1;
+
+void stop_handler(int sig) {
+    running = 0;
+}
+
 int main(int argc, char const *argv[]) {
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
         return -1;
     }
 
+    map_init(&http_pending_table, sizeof(http_key_t), sizeof(http_pending_t), 0, HTTP_PENDING_TIMEOUT_SEC, NULL, NULL, NULL, NULL, NULL);
     tcp_open(HTTP_LISTEN_PORT, http_request_handler);  // 注册端口的tcp监听回调
 
-    while (1) {
+    signal(SIGINT, stop_handler);  // 收到信号后退出主循环，正常关闭协议栈
+    signal(SIGTERM, stop_handler);
+    while (running) {
         net_poll();  // 一次主循环
     }
 
+    net_close();
     return 0;
 }
@@ -22,12 +22,58 @@ typedef struct arp_pkt {
 
 #pragma pack()
 
+typedef struct arp_entry  // arp表项，arp_table的值
+{
+    uint8_t mac[NET_MAC_LEN];  // mac地址，放在最前面，可当作mac地址使用
+    time_t probed;             // 最近一次刷新探测的时间，net_now()的毫秒数，0为未探测
+    uint8_t permanent;         // 为1则是静态表项，永不过期，不被收到的arp包覆盖
+} arp_entry_t;
+
+typedef struct arp_cache  // 调用者持有的下一跳mac缓存，如每个tcp连接一个，命中时不查arp表
+{
+    uint8_t ip[NET_IP_LEN];    // 下一跳ip地址
+    uint8_t mac[NET_MAC_LEN];  // 解析到的mac地址
+    uint32_t generation;       // 填入时arp表的版本，arp表修改后失效，0为无效
+    time_t valid_until;        // 过了这个时间须重新查表，使快要过期的表项照常被探测刷新
+} arp_cache_t;
+
+typedef struct arp_pending  // 一个待解析地址的状态：排队等待发送的数据包（先进先出的环形队列）和请求的重发
+{
+    buf_t bufs[ARP_PENDING_MAX];  // 数据包，与ip层共享存储块而不拷贝
+    uint8_t head;                 // 队首下标
+    uint8_t count;                // 数据包个数
+    uint8_t requests;             // 已广播的请求数
+    uint8_t unreachable;          // 为1则请求用尽仍无响应，处于负缓存中，没有排队的数据包
+    time_t deadline;              // 下一次重发请求（或放弃、负缓存到期）的时间，net_now()的毫秒数
+} arp_pending_t;
+
+typedef struct arp_stats  // arp的统计
+{
+    uint64_t pending_queued;    // 缓存的数据包数
+    uint64_t pending_flushed;   // 解析成功后发出的数据包数
+    uint64_t pending_overflow;  // 队列已满被丢弃的数据包数
+    uint64_t pending_expired;   // 等待解析超时被丢弃的数据包数
+    uint64_t refresh_probes;    // 表项过期前发出的单播探测数
+    uint64_t requests;          // 广播的请求数，含重发
+    uint64_t retries;           // 其中重发的请求数
+    uint64_t rate_limited;      // 因全局限速而推迟的请求数
+    uint64_t unresolved;        // 请求用尽仍无响应、进入负缓存的地址数
+    uint64_t negative_drops;    // 发往负缓存中的地址而被丢弃的数据包数
+    uint64_t cache_hits;        // 命中调用者的下一跳缓存、不查arp表直接发送的数据包数
+} arp_stats_t;
+
 void arp_init();
 void arp_print();
 void arp_in(buf_t *buf, uint8_t *src_mac);
 void arp_out(buf_t *buf, uint8_t *ip);
+void arp_out_cached(buf_t *buf, uint8_t *ip, arp_cache_t *cache);
 void arp_req(uint8_t *target_ip);
+void arp_probe(uint8_t *target_ip, uint8_t *target_mac);
 void arp_resp(uint8_t *target_ip, uint8_t *target_mac);
+void arp_pending_free(void *pending);
+int arp_load(const char *path, int permanent);
+int arp_save(const char *path);
+const arp_stats_t *arp_get_stats();
 #endif
 
 // 注意到，其他协议的定义的都是头，arp定义的不是头，而是直接是arp_pkt_t,为什么？
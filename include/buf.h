@@ -6,18 +6,53 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#define BUF_CSUM_VALID (1 << 0)    // 接收：驱动后端已校验过传输层校验和
+#define BUF_CSUM_PARTIAL (1 << 1)  // 发送：校验和字段只填了伪头部和，由驱动后端补全
+#define BUF_GSO (1 << 2)           // 发送：超过MTU的报文由驱动后端分段，IP层不再分片
+#define BUF_CSUM_PAYLOAD (1 << 3)  // 发送：csum中是数据末尾csum_len字节的部分和，计算校验和时只需再累加头部
+
+typedef struct buf_block buf_block_t;  // 缓冲池中的存储块，定义在buf.c中
+
 typedef struct buf  // 协议栈的通用数据包buffer, 可以在头部装卸数据，以供协议头的添加和去除
 {
-    size_t len;                    // 包中有效数据大小
-    uint8_t *data;                 // 包的数据起始地址
-    uint8_t payload[BUF_MAX_LEN];  // 最大负载数据量
+    size_t len;                // 包中有效数据大小
+    uint8_t *data;             // 包的数据起始地址
+    uint8_t *borrowed;         // 借用的外部内存（如驱动的接收缓冲区）起始地址，为NULL则数据在block中
+    size_t borrowed_len;       // 借用的外部内存长度
+    uint8_t flags;             // 与驱动后端卸载相关的标志，BUF_CSUM_VALID等
+    uint16_t csum;             // BUF_CSUM_PAYLOAD时有效，拷贝负载时顺带算出的16位反码和（未取反）
+    size_t csum_len;           // BUF_CSUM_PAYLOAD时有效，csum覆盖的负载长度
+    buf_block_t *block;        // 从缓冲池分配的存储块，为NULL则尚未分配；buf_t须零初始化后使用
+    uint8_t *slice;            // 分散聚合：紧接在data之后发送的第二段数据，指向其他buffer的负载而不拷贝，为NULL则没有
+    size_t slice_len;          // 第二段数据的长度，不计入len
+    buf_block_t *slice_block;  // 第二段数据所在的块，持有其一个引用；为NULL则是借用的外部内存
 } buf_t;
 
+#define BUF_CLASS_NUM 3  // 缓冲池大小类的个数：MTU、巨型帧、最大
+
+typedef struct buf_pool_stats  // 缓冲池一个大小类的使用统计
+{
+    size_t block_size;  // 块容量
+    size_t total;       // 已向系统申请的块数
+    size_t in_use;      // 正在使用的块数
+    size_t peak;        // 同时使用块数的峰值
+    uint64_t allocs;    // 分配次数
+    uint64_t grows;     // 空闲链表为空、向系统申请内存的次数
+} buf_pool_stats_t;
+
 int buf_init(buf_t *buf, size_t len);
 int buf_add_header(buf_t *buf, size_t len);
 int buf_remove_header(buf_t *buf, size_t len);
 int buf_add_padding(buf_t *buf, size_t len);
 int buf_remove_padding(buf_t *buf, size_t len);
 void buf_copy(void *pdst, const void *psrc, size_t len);
+void buf_borrow(buf_t *buf, uint8_t *data, size_t len);
+int buf_detach(buf_t *buf);
+void buf_ref(void *pdst, const void *psrc, size_t len);
+void buf_unref(buf_t *buf);
+int buf_slice(buf_t *buf, const buf_t *src, size_t offset, size_t len);
+int buf_linearize(buf_t *buf);
+size_t buf_capacity(const buf_t *buf);
+const buf_pool_stats_t *buf_get_pool_stats();
 
 #endif
\ No newline at end of file
@@ -10,6 +10,10 @@
     {                                      \
         0x11, 0x22, 0x33, 0x44, 0x55, 0x66 \
     }  // 测试用网卡mac地址
+#define NET_IF_NETMASK     \
+    {                      \
+        255, 255, 255, 0   \
+    }  // 测试用网卡子网掩码
 #else
 #define NET_IF_IP        \
     {                    \
@@ -20,16 +24,76 @@
     {                                      \
         0x00, 0x11, 0x22, 0x33, 0x44, 0x55 \
     }  // 自定义网卡mac地址
+#define NET_IF_NETMASK   \
+    {                    \
+        255, 255, 0, 0   \
+    }  // 自定义网卡子网掩码
 #endif
+#define NET_IF_GATEWAY \
+    {                  \
+        0, 0, 0, 0     \
+    }  // 默认网关，为0.0.0.0则不添加默认路由，没有匹配路由的目的地址按直连处理
 
 #define ETHERNET_MAX_TRANSPORT_UNIT 1500  // 以太网最大传输单元
+#define ETHERNET_RX_BATCH 32              // 每次以太网轮询默认最多接收的帧数
+#define ETHERNET_RX_BATCH_MAX 64          // 每次以太网轮询最多接收帧数的上限
+
+#define NET_IF_MTU ETHERNET_MAX_TRANSPORT_UNIT  // 网卡默认MTU，可用net_set_mtu修改
+#define NET_IF_MIN_MTU 68                       // 网卡MTU下限，IPv4要求的最小值
+#define NET_IF_MAX_MTU 9000                     // 网卡MTU上限，巨型帧
+
+#define NET_POLL_BUSY_US 200      // 混合轮询模式下，收到数据后继续忙轮询的时间（微秒）
+#define NET_POLL_MAX_WAIT_MS 100  // 事件轮询模式下没有待处理定时器时，单次最长阻塞时间（毫秒）
+
+#define TIMER_WHEEL_LEVELS 4  // 定时器时间轮层数，每层64格，底层1毫秒一格，最长可定时约4.6小时
 
 #define ARP_TIMEOUT_SEC (60 * 5)  // arp表过期时间
-#define ARP_MIN_INTERVAL 1        // 向相同地址发送arp请求的最小间隔
+#define ARP_MIN_INTERVAL 1        // 向相同地址发送arp请求的最小间隔，也是第一次重发前的等待时间，之后每次加倍
+#define ARP_MAX_REQUESTS 3        // 每个地址最多广播的arp请求数，都没有响应则认为不可达
+#define ARP_NEGATIVE_SEC 20       // 不可达地址的负缓存时间，期间发往它的数据包直接丢弃
+#define ARP_BROADCAST_RATE 50     // 全局每秒最多广播的arp请求数，超过的推迟发送
+#define ARP_BROADCAST_BURST 16    // 全局可连续广播的arp请求数
+#define ARP_PENDING_MAX 8         // 每个待解析地址最多缓存的数据包数，超过的丢弃
+#define ARP_REFRESH_SEC 30        // 表项过期前这么多秒内仍在使用时，单播探测刷新，须大于ARP_MIN_INTERVAL
+
+#ifdef TEST
+#define ARP_STATIC_FILE NULL  // 测试不读写文件
+#define ARP_CACHE_FILE NULL
+#else
+#define ARP_STATIC_FILE "arp_static.conf"  // 静态arp表项文件，每行“ip mac”，#开始注释；其中的表项永不过期，不被收到的arp包覆盖
+#define ARP_CACHE_FILE "arp_cache.conf"    // 关闭时保存学到的arp表、启动时重新载入的文件，每行“ip mac 更新时间”，为NULL则不保存
+#endif
 
 #define IP_DEFALUT_TTL 64  // IP默认TTL
 
-#define BUF_MAX_LEN (2 * UINT16_MAX + UINT8_MAX)  // buf最大长度
+#ifndef IP_PMTU_DISCOVERY  // 可由编译选项指定，如路径MTU的测试
+#ifdef TEST
+#define IP_PMTU_DISCOVERY 0  // 测试回放的报文不带DF位
+#else
+#define IP_PMTU_DISCOVERY 1  // 路径MTU发现：不分片的数据包置DF位，按收到的“需要分片”差错降低路径MTU
+#endif
+#endif
+#define IP_PMTU_MIN 552          // 路径MTU下限，收到更小的值时按下限处理并不再置DF位
+#define IP_PMTU_TIMEOUT_SEC 600  // 降低的路径MTU的有效期，过期后恢复网卡MTU重新探测
+
+#define IP_REASM_MAX_DATAGRAMS 16          // 同时重组的数据包个数上限
+#define IP_REASM_MAX_HOLES 16              // 每个重组中的数据包最多记录的空洞数，超过则放弃该数据包
+#define IP_REASM_MAX_MEM (8 * UINT16_MAX)  // 重组缓冲区占用的总字节数上限，超过时淘汰最早的数据包
+#define IP_REASM_TIMEOUT_SEC 30            // 分片重组超时时间
+
+#define UDP_FLOW_CACHE_SIZE 64  // udp按目的地址缓存下一跳mac的槽位数，须为2的幂
+
+#define ROUTE_MAX_ENTRIES 64  // 路由表最多的路由条数
+#define ROUTE_MAX_NODES 64    // 路由前缀树最多的节点数，每个节点约768字节
+#define ROUTE_CACHE_SIZE 256  // 下一跳缓存的槽位数，须为2的幂且不超过65536
+
+#define BUF_MAX_LEN (2 * UINT16_MAX + UINT8_MAX)             // buf最大长度，即缓冲池最大大小类的块容量
+#define BUF_HEADROOM 128                                     // 新分配的buf在数据前预留给各层协议头的空间
+#define BUF_TAILROOM 64                                      // 新分配的buf在数据后预留给填充的空间
+#define BUF_MTU_SIZE 2048                                    // 缓冲池MTU大小类的块容量
+#define BUF_JUMBO_SIZE (9216 + BUF_HEADROOM + BUF_TAILROOM)  // 缓冲池巨型帧大小类的块容量
+#define BUF_POOL_GROW 16                                     // 空闲链表为空时一次向系统申请的块数
 
 #define MAP_MAX_LEN (16 * BUF_MAX_LEN)  // map最大长度
+#define MAP_MAX_LOAD 75                 // map哈希表的最大装载率（百分比），超过后插入失败
 #endif
\ No newline at end of file
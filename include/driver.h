@@ -6,8 +6,29 @@
 #ifndef PCAP_BUF_SIZE
 #define PCAP_BUF_SIZE 1024
 #endif
+
+#define DRIVER_RING_BLOCK_SIZE (1 << 16)  // AF_PACKET环形缓冲区块大小
+#define DRIVER_RING_FRAME_SIZE 2048       // AF_PACKET环形缓冲区帧大小
+#define DRIVER_RING_BLOCK_TIMEOUT_MS 1    // AF_PACKET接收块未满时的最长等待时间（毫秒）
+#define DRIVER_RX_RING_BLOCK_NUM 64       // AF_PACKET接收环块数
+#define DRIVER_TX_RING_BLOCK_NUM 16       // AF_PACKET发送环块数
+
+#define DRIVER_TX_BATCH 32  // 发送队列中积累到该帧数时立即批量发出，否则在driver_flush时发出
+
+#define DRIVER_TAP_DEFAULT_NAME "tap0"  // TAP后端未指定NET_IF_NAME时使用的设备名
+
+#define DRIVER_OFFLOAD_CSUM (1 << 0)  // 驱动后端可代为计算/校验传输层校验和
+#define DRIVER_OFFLOAD_TSO (1 << 1)   // 驱动后端可对超过MTU的TCP报文分段
+#define DRIVER_OFFLOAD_UFO (1 << 2)   // 驱动后端可对超过MTU的UDP报文分片
+
+typedef void (*driver_handler_t)(buf_t *buf);  // 接收处理程序，buf借用驱动的内存，只在处理程序返回前有效
+
 int driver_open();
 int driver_recv(buf_t *buf);
+int driver_recv_batch(driver_handler_t handler, int max);
 int driver_send(buf_t *buf);
+int driver_flush();
 void driver_close();
+int driver_offload();
+int driver_fd();
 #endif
\ No newline at end of file
@@ -14,9 +14,21 @@ typedef struct ether_hdr {
     uint16_t protocol16;       // 协议/长度
 } ether_hdr_t;
 #pragma pack()
+
+typedef struct ethernet_stats {
+    int rx_batch;         // 当前批大小，即每次轮询最多接收的帧数
+    int rx_batch_last;    // 最近一个非空批次收到的帧数
+    int rx_batch_peak;    // 单个批次收到的最多帧数
+    uint64_t polls;       // 轮询次数
+    uint64_t rx_batches;  // 收到数据的轮询次数
+    uint64_t rx_frames;   // 收到的帧数
+} ethernet_stats_t;
+
 void ethernet_init();
 void ethernet_in(buf_t *buf);
 void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol);
-void ethernet_poll();
+int ethernet_poll();
+void ethernet_set_rx_batch(int batch);
+const ethernet_stats_t *ethernet_get_stats();
 static const uint8_t ether_broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};  // 以太网广播mac地址
 #endif
\ No newline at end of file
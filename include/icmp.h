@@ -21,7 +21,8 @@ typedef enum icmp_type {
 
 typedef enum icmp_code {
     ICMP_CODE_PROTOCOL_UNREACH = 2,  // 协议不可达
-    ICMP_CODE_PORT_UNREACH = 3       // 端口不可达
+    ICMP_CODE_PORT_UNREACH = 3,      // 端口不可达
+    ICMP_CODE_FRAG_NEEDED = 4        // 需要分片但设置了DF位
 } icmp_code_t;
 void icmp_in(buf_t *buf, uint8_t *src_ip);
 void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code);
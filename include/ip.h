@@ -1,6 +1,7 @@
 #ifndef IP_H
 #define IP_H
 
+#include "arp.h"
 #include "net.h"
 
 #pragma pack(1)
@@ -19,11 +20,28 @@ typedef struct ip_hdr {
 } ip_hdr_t;
 #pragma pack()
 
-#define IP_HDR_LEN_PER_BYTE 4       // ip包头长度单位
-#define IP_HDR_OFFSET_PER_BYTE 8    // ip分片偏移长度单位
-#define IP_VERSION_4 4              // ipv4
-#define IP_MORE_FRAGMENT (1 << 13)  // ip分片mf位
+#define IP_HDR_LEN_PER_BYTE 4           // ip包头长度单位
+#define IP_HDR_OFFSET_PER_BYTE 8        // ip分片偏移长度单位
+#define IP_VERSION_4 4                  // ipv4
+#define IP_MORE_FRAGMENT (1 << 13)      // ip分片mf位
+#define IP_DONT_FRAGMENT (1 << 14)      // ip分片df位
+#define IP_FRAGMENT_OFFSET_MASK 0x1FFF  // ip分片偏移字段，8字节为单位
+#define IP_MAX_PAYLOAD (UINT16_MAX - sizeof(ip_hdr_t))  // ip数据包最大负载长度
+
+typedef struct ip_reasm_stats  // 分片重组的统计
+{
+    uint64_t reassembled;  // 重组完成的数据包数
+    uint64_t timeouts;     // 超时放弃的数据包数
+    uint64_t overlaps;     // 与已收到的数据重叠的分片数
+    uint64_t evictions;    // 因个数、空洞数或内存上限被淘汰的数据包数
+    size_t mem;            // 当前重组缓冲区持有的块容量之和
+} ip_reasm_stats_t;
+
 void ip_in(buf_t *buf, uint8_t *src_mac);
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
+void ip_out_cached(buf_t *buf, uint8_t *ip, net_protocol_t protocol, arp_cache_t *cache);
 void ip_init();
+const ip_reasm_stats_t *ip_reasm_get_stats();
+uint16_t ip_pmtu(const uint8_t *dst_ip);
+void ip_pmtu_update(const uint8_t *dst_ip, uint16_t mtu, uint16_t sent_len);
 #endif
\ No newline at end of file
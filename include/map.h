@@ -8,25 +8,35 @@
 #include <time.h>
 
 typedef int (*map_compare_t)(const void *a, const void *b, size_t n);
+typedef uint32_t (*map_hash_t)(const void *key, size_t len);
 typedef void (*map_constuctor_t)(void *dst, const void *src, size_t len);
+typedef void (*map_destructor_t)(void *value);
+typedef int (*map_persistent_t)(const void *value);
 typedef void (*map_entry_handler_t)(void *key, void *value, time_t *timestamp);
 
-typedef struct map  // 协议栈的通用泛型map，即键值对的容器，支持超时时间与非平凡值类型
+typedef struct map  // 协议栈的通用泛型map，即键值对的容器，支持超时时间与非平凡值类型。使用线性探测的开放寻址哈希表实现
 {
     size_t key_len;                     // 键的长度
     size_t value_len;                   // 值的长度
-    size_t size;                        // 当前大小
+    size_t size;                        // 当前大小，含已超时但尚未清理的键值对
     size_t max_size;                    // 最大容量
-    time_t timeout;                     // 超时时间，0为永不超时
+    size_t slots;                       // 哈希表槽位数，为2的幂且大于max_size
+    size_t entry_len;                   // 每个槽位的长度，含对齐填充
+    time_t timeout;                     // 超时秒数，0为永不超时，按net_now()计时
     map_compare_t key_compare;          // 形如memcmp/strncmp的值构造函数，用于比较两个key的大小
+    map_hash_t key_hash;                // 键的哈希函数，比较相等的键必须有相同的哈希值
     map_constuctor_t value_constuctor;  // 形如memcpy的值构造函数，用于拷贝非平凡数据结构到容器中，如buf_copy
+    map_destructor_t value_destructor;  // 值析构函数，值被覆盖、删除或超时后被清理时调用，如buf_unref，为NULL则不调用
+    map_persistent_t value_persistent;  // 返回非0的值永不超时，为NULL则都按timeout超时
     uint8_t data[MAP_MAX_LEN];          // 数据
 } map_t;
 
-void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_compare_t key_compare, map_constuctor_t value_constuctor);
+void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_compare_t key_compare, map_hash_t key_hash, map_constuctor_t value_constuctor, map_destructor_t value_destructor, map_persistent_t value_persistent);
 size_t map_size(map_t *map);
 void *map_get(map_t *map, const void *key);
+void *map_get_time(map_t *map, const void *key, time_t *updated);
 int map_set(map_t *map, const void *key, const void *value);
+int map_set_time(map_t *map, const void *key, const void *value, time_t updated);
 void map_delete(map_t *map, const void *key);
 void map_foreach(map_t *map, map_entry_handler_t handler);
 
@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 typedef enum net_protocol {
     NET_PROTOCOL_ARP = 0x0806,
     NET_PROTOCOL_IP = 0x0800,
@@ -16,16 +17,30 @@ typedef enum net_protocol {
 } net_protocol_t;
 
 typedef void (*net_handler_t)(buf_t *buf, uint8_t *src);
+typedef time_t (*net_clock_t)();  // 时钟源，返回单调递增的毫秒数
+
+typedef enum net_poll_mode {
+    NET_POLL_BUSY,    // 忙轮询，没有数据也立即返回
+    NET_POLL_EVENT,   // 没有数据时阻塞在网卡的文件描述符上，直到数据到达或下一个定时器到期
+    NET_POLL_HYBRID,  // 收到数据后先忙轮询一段时间，空闲后再阻塞
+} net_poll_mode_t;
 
 #define NET_MAC_LEN 6  // mac地址长度
 #define NET_IP_LEN 4   // ip地址长度
 
 extern uint8_t net_if_mac[NET_MAC_LEN];
 extern uint8_t net_if_ip[NET_IP_LEN];
+extern uint16_t net_if_mtu;
 extern buf_t rxbuf, txbuf;  // 一个buf足够单线程使用
 
 int net_init();
+void net_close();
 void net_poll();
+int net_set_mtu(uint16_t mtu);
+void net_set_poll_mode(net_poll_mode_t mode, int busy_us);
+time_t net_now();
+void net_clock_update();
+void net_set_clock(net_clock_t clock);
 int net_in(buf_t *buf, uint16_t protocol, uint8_t *src);
 void net_add_protocol(uint16_t protocol, net_handler_t handler);
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "net.h"
+
+#define ROUTE_STRIDE 8                                // 前缀树每层消耗的位数
+#define ROUTE_FANOUT (1 << ROUTE_STRIDE)              // 前缀树每个节点的分支数
+#define ROUTE_LEVELS (NET_IP_LEN * 8 / ROUTE_STRIDE)  // 前缀树层数，查找最多访问这么多个节点
+
+typedef struct route_entry  // 一条路由
+{
+    uint8_t prefix[NET_IP_LEN];   // 目的网络，主机位为0
+    uint8_t prefix_len;           // 前缀长度
+    uint8_t gateway[NET_IP_LEN];  // 下一跳，为0.0.0.0则直连
+} route_entry_t;
+
+typedef struct route_stats  // 路由查找的统计
+{
+    uint64_t lookups;     // 查找次数
+    uint64_t cache_hits;  // 命中下一跳缓存的次数
+    uint64_t misses;      // 没有匹配的路由、按直连处理的次数
+    uint32_t generation;  // 路由表版本，每次修改加1，使下一跳缓存失效
+} route_stats_t;
+
+void route_init();
+int route_add(const uint8_t *prefix, uint8_t prefix_len, const uint8_t *gateway);
+int route_delete(const uint8_t *prefix, uint8_t prefix_len);
+const uint8_t *route_lookup(const uint8_t *dst_ip);
+void route_print();
+const route_stats_t *route_get_stats();
+#endif
@@ -1,6 +1,7 @@
 #ifndef TCP_H
 #define TCP_H
 
+#include "arp.h"
 #include "net.h"
 
 #pragma pack(1)
@@ -46,6 +47,26 @@ typedef struct tcp_connection {
     int port;
     uint32_t seq;  // 要发送的序列号
     uint32_t ack;  // 要发送的 ACK
+
+    arp_cache_t next_hop;  // 下一跳mac缓存，稳定状态下发送报文不查arp表
+
+    /* 发送缓冲区与重传，seq即下一个要发送的新数据的序列号 */
+    buf_t snd_buf;          // 发送缓冲区，第一次发送数据时分配，snd_buf.data + snd_off 处是序列号为 snd_una 的字节
+    size_t snd_off;         // 缓冲数据在 snd_buf 中的起始偏移
+    size_t snd_len;         // 缓冲的字节数，包括已发送未确认的和未发送的
+    size_t snd_sent;        // 其中已发送未确认的字节数
+    uint32_t snd_una;       // 最早未确认的数据的序列号
+    uint32_t snd_wnd;       // 对端通告的接收窗口
+    uint8_t snd_blocked;    // 为1则 tcp_send 曾因缓冲区满未能放入全部数据，有了空间时通知应用继续发送
+    uint8_t dup_acks;       // 连续收到的重复 ACK 数
+    uint8_t retransmits;    // 同一数据连续超时重传的次数
+    uint8_t rtt_timing;     // 为1则正在对一个报文段计时测量 RTT
+    uint32_t rtt_seq;       // 计时的报文段的结束序列号，确认号达到它时得到一个 RTT 样本
+    time_t rtt_start;       // 计时的报文段的发送时间，net_now()的毫秒数
+    time_t srtt;            // 平滑的 RTT（毫秒），0为还没有样本
+    time_t rttvar;          // RTT 的平均偏差（毫秒）
+    time_t rto;             // 重传超时（毫秒）
+    time_t rto_deadline;    // 重传定时器的到期时间，net_now()的毫秒数，0为未启动
 } tcp_conn_t;
 
 #define TCP_FLG_URG (1 << 5)
@@ -58,10 +79,17 @@ typedef struct tcp_connection {
 #define TCP_FLG_ISSET(x, y) (((x & 0x3f) & (y)) ? 1 : 0)
 
 #define TCP_HEADER_LEN 20
-#define TCP_RETRANSMISSON_TIMEOUT 3
+#define TCP_RETRANSMISSON_TIMEOUT 3          // 还没有 RTT 样本时的重传超时（秒）
+#define TCP_RTO_MIN_MS 200                   // 重传超时下限（毫秒）
+#define TCP_RTO_MAX_MS 60000                 // 重传超时上限（毫秒），超时后每次加倍直到此值
+#define TCP_MAX_RETRANSMITS 8                // 同一数据连续超时重传的次数上限，超过则关闭连接
+#define TCP_DUP_ACK_THRESHOLD 3              // 收到这么多个重复 ACK 时快速重传
+#define TCP_SEND_BUF_SIZE (2 * UINT16_MAX)   // 每个连接的发送缓冲区大小，须能放进缓冲池最大的块
 #define TCP_MAX_WINDOW_SIZE UINT16_MAX
 #define TCP_MAX_CONN_NUM (MAP_MAX_LEN / (sizeof(tcp_key_t) + sizeof(tcp_conn_t) + sizeof(time_t)))
 
+// 处理程序：收到数据时调用；data为NULL、len为0时表示发送缓冲区有了空间，tcp_send 未放入的数据可以继续发送；
+// tcp_conn也为NULL时表示连接已关闭或被重置
 typedef void (*tcp_handler_t)(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port);
 
 void tcp_init();
@@ -70,5 +98,5 @@ void tcp_close(uint16_t port);
 
 void tcp_in(buf_t *buf, uint8_t *src_ip);
 void tcp_out(tcp_conn_t *tcp_conn, buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, uint8_t flags);
-void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+int tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define TIMER_WHEEL_BITS 6                          // 每层时间轮槽位数的位数
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)  // 每层时间轮的槽位数，与占用位图的位数一致
+
+typedef void (*timer_handler_t)(void *arg);
+
+typedef struct timer_event  // 定时器，嵌入到使用者的结构体中，由使用者分配内存
+{
+    struct timer_event *next;    // 同一槽位中的下一个定时器
+    struct timer_event **pprev;  // 指向前一个定时器的next（或槽位头），为NULL则未在等待
+    time_t expires;              // 到期时间，net_now()的毫秒数
+    uint16_t slot;               // 所在的槽位，层号 * TIMER_WHEEL_SLOTS + 层内下标
+    timer_handler_t handler;     // 到期时调用的回调函数
+    void *arg;                   // 回调函数的参数
+} timer_event_t;
+
+void timer_init();
+void timer_setup(timer_event_t *timer, timer_handler_t handler, void *arg);
+void timer_add(timer_event_t *timer, time_t delay_ms);
+void timer_cancel(timer_event_t *timer);
+int timer_pending(const timer_event_t *timer);
+void timer_poll();
+time_t timer_next();
+#endif
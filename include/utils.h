@@ -6,8 +6,19 @@
 #include <stdint.h>
 #include <time.h>
 
+typedef enum checksum_impl {
+    CHECKSUM_IMPL_AUTO,    // 按CPUID自动选择
+    CHECKSUM_IMPL_SCALAR,  // 原始的逐字累加循环，由编译器自动向量化
+    CHECKSUM_IMPL_AVX2,    // AVX2向量实现
+} checksum_impl_t;
+
 uint16_t checksum16(uint16_t *data, size_t len);
+uint16_t checksum_copy(void *dst, const void *src, size_t len);
+uint16_t checksum16_update(uint16_t checksum, const void *old_data, const void *new_data, size_t len);
+int checksum_select(checksum_impl_t impl);
+checksum_impl_t checksum_get_impl();
 uint16_t transport_checksum(uint8_t protocol, buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip);
+uint16_t transport_pseudo_checksum(uint8_t protocol, uint16_t len, uint8_t *src_ip, uint8_t *dst_ip);
 
 #define swap16(x) ((((x)&0xFF) << 8) | (((x) >> 8) & 0xFF))                                                  // 为16位数据交换大小端
 #define swap32(x) ((((x)&0xFF) << 24) | (((x)&0xFF00) << 8) | (((x)&0xFF0000) >> 8) | (((x) >> 24) & 0xFF))  // 为32位数据交换大小端
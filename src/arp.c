@@ -2,6 +2,7 @@
 
 #include "ethernet.h"
 #include "net.h"
+#include "timer.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -19,26 +20,83 @@ static const arp_pkt_t arp_init_pkt = {
     .target_mac = {0}};
 
 /**
- * @brief arp地址转换表，<ip,mac>的容器
+ * @brief arp地址转换表，<ip,arp_entry_t>的容器
  *
  */
 map_t arp_table;
 
 /**
- * @brief arp buffer，<ip,buf_t>的容器
+ * @brief arp buffer，<ip,arp_pending_t>的容器
  *
  */
 map_t arp_buf;
 
+/**
+ * @brief arp的统计
+ *
+ */
+static arp_stats_t arp_stats;
+
+/**
+ * @brief arp表的版本，表项的mac地址改变时加一，使调用者的下一跳缓存失效。
+ * 缓存的有效期在表项进入刷新窗口时结束，早于表项过期，所以过期不必更新版本；arp表的表项不会被删除
+ *
+ */
+static uint32_t arp_generation;
+
+/**
+ * @brief 内部函数，写入arp表项，mac地址与原有表项不同时更新版本
+ *
+ * @param ip 表项的ip地址
+ * @param entry 新的表项
+ * @param updated 更新时间，net_now()的毫秒数
+ * @return int 成功为0，表满为-1
+ */
+static int arp_entry_set(uint8_t *ip, arp_entry_t *entry, time_t updated) {
+    arp_entry_t *old = map_get(&arp_table, ip);
+    if (old && memcmp(old->mac, entry->mac, NET_MAC_LEN))
+        arp_generation++;
+    return map_set_time(&arp_table, ip, entry, updated);
+}
+
+/**
+ * @brief 全局广播请求的令牌桶，令牌以千分之一个为单位
+ *
+ */
+static struct {
+    time_t updated;    // 上次补充令牌的时间，net_now()的毫秒数
+    uint32_t tokens;   // 剩余的令牌
+} arp_bucket;
+
+/**
+ * @brief 到期时处理arp_buf中待重发的请求
+ *
+ */
+static timer_event_t arp_retry_timer;
+
+/**
+ * @brief 释放待解析地址上排队的数据包，作为arp_buf的值析构函数，剩下的数据包计为超时丢弃
+ *
+ * @param pending 要释放的队列
+ */
+void arp_pending_free(void *pending) {
+    arp_pending_t *queue = pending;
+    arp_stats.pending_expired += queue->count;
+    for (int i = 0; i < queue->count; i++)
+        buf_unref(&queue->bufs[(queue->head + i) % ARP_PENDING_MAX]);
+    queue->count = 0;
+}
+
 /**
  * @brief 打印一条arp表项
  *
  * @param ip 表项的ip地址
  * @param mac 表项的mac地址
- * @param timestamp 表项的更新时间
+ * @param timestamp 表项的更新时间，net_now()的毫秒数
  */
 void arp_entry_print(void *ip, void *mac, time_t *timestamp) {
-    printf("%s | %s | %s\n", iptos(ip), mactos(mac), timetos(*timestamp));
+    time_t updated = time(NULL) - (net_now() - *timestamp) / 1000;  // 换算为日历时间
+    printf("%s | %s | %s\n", iptos(ip), mactos(mac), timetos(updated));
 }
 
 /**
@@ -57,6 +115,16 @@ void arp_print() {
  * @param target_ip 想要知道的目标的ip地址
  */
 void arp_req(uint8_t *target_ip) {
+    arp_probe(target_ip, NULL);
+}
+
+/**
+ * @brief 发送一个arp请求，可以单播给已知的mac地址
+ *
+ * @param target_ip 想要知道的目标的ip地址
+ * @param target_mac 目标当前的mac地址，单播探测以刷新表项；为NULL则广播
+ */
+void arp_probe(uint8_t *target_ip, uint8_t *target_mac) {
     // TO-DO
 
     // 如果我们需要发包，就应该用发送缓冲区，先初始化成一个arp包
@@ -81,7 +149,7 @@ void arp_req(uint8_t *target_ip) {
     arp_pkt->opcode16 = swap16(ARP_REQUEST);
 
     // 调用ethernet_out发送数据包
-    ethernet_out(&txbuf, ether_broadcast_mac, NET_PROTOCOL_ARP);
+    ethernet_out(&txbuf, target_mac ? target_mac : ether_broadcast_mac, NET_PROTOCOL_ARP);
 }
 
 /**
@@ -110,6 +178,94 @@ void arp_resp(uint8_t *target_ip, uint8_t *target_mac) {
 
 }
 
+/**
+ * @brief 内部函数，从令牌桶中取一个广播请求的令牌
+ *
+ * @return int 取到为1，被限速为0
+ */
+static int arp_bucket_take() {
+    time_t now = net_now();
+    uint64_t tokens = arp_bucket.tokens + (uint64_t)(now - arp_bucket.updated) * ARP_BROADCAST_RATE;
+    arp_bucket.tokens = tokens > ARP_BROADCAST_BURST * 1000 ? ARP_BROADCAST_BURST * 1000 : tokens;
+    arp_bucket.updated = now;
+    if (arp_bucket.tokens < 1000)
+        return 0;
+    arp_bucket.tokens -= 1000;
+    return 1;
+}
+
+/**
+ * @brief 内部函数，在deadline时处理待重发的请求，已有更早的定时则不变
+ *
+ * @param deadline 时间，net_now()的毫秒数
+ */
+static void arp_retry_schedule(time_t deadline) {
+    if (!timer_pending(&arp_retry_timer) || arp_retry_timer.expires > deadline)
+        timer_add(&arp_retry_timer, deadline - net_now());
+}
+
+/**
+ * @brief 内部函数，为待解析地址广播一次请求，并定下次重发的时间，重发间隔每次加倍；
+ * 被全局限速时推迟到下一个令牌可用时
+ *
+ * @param ip 目标ip地址
+ * @param pending 目标在arp_buf中的状态
+ */
+static void arp_pending_request(uint8_t *ip, arp_pending_t *pending) {
+    if (arp_bucket_take()) {
+        if (pending->requests)
+            arp_stats.retries++;
+        arp_stats.requests++;
+        pending->deadline = net_now() + ((time_t)ARP_MIN_INTERVAL * 1000 << pending->requests);
+        pending->requests++;
+        arp_req(ip);
+    } else {
+        arp_stats.rate_limited++;
+        pending->deadline = net_now() + (1000 + ARP_BROADCAST_RATE - 1) / ARP_BROADCAST_RATE;
+    }
+    arp_retry_schedule(pending->deadline);
+}
+
+static time_t arp_retry_next;  // 一轮处理中剩下的最早的时间，-1为没有
+
+/**
+ * @brief 内部函数，处理arp_buf中的一个地址：到时间则重发请求；请求用尽则丢弃排队的数据包，转为负缓存；负缓存到期则删除
+ *
+ * @param ip 目标ip地址
+ * @param value 目标的状态
+ * @param timestamp 更新时间
+ */
+static void arp_retry_entry(void *ip, void *value, time_t *timestamp) {
+    arp_pending_t *pending = value;
+    if (pending->deadline <= net_now()) {
+        if (pending->unreachable) {
+            map_delete(&arp_buf, ip);
+            return;
+        }
+        if (pending->requests < ARP_MAX_REQUESTS) {
+            arp_pending_request(ip, pending);
+        } else {
+            arp_pending_free(pending);
+            arp_stats.unresolved++;
+            pending->unreachable = 1;
+            pending->deadline = net_now() + ARP_NEGATIVE_SEC * 1000;
+        }
+    }
+    if (arp_retry_next < 0 || pending->deadline < arp_retry_next)
+        arp_retry_next = pending->deadline;
+}
+
+/**
+ * @brief 定时器回调，处理到期的重发请求，并按剩下最早的时间重新定时
+ *
+ */
+static void arp_retry(void *arg) {
+    arp_retry_next = -1;
+    map_foreach(&arp_buf, arp_retry_entry);
+    if (arp_retry_next >= 0)
+        arp_retry_schedule(arp_retry_next);
+}
+
 /**
  * @brief 处理一个收到的数据包
  *
@@ -131,12 +287,21 @@ void arp_in(buf_t *buf, uint8_t *src_mac) {
                     if(arp_pkt->opcode16 == swap16(0x1) || arp_pkt->opcode16 == swap16(2)) {
                         // 所有检查通过
                         // map_set(&arp_table, arp_pkt->sender_ip, arp_pkt->sender_mac);  // 设置arp表
-                        map_set(&arp_table, arp_pkt->sender_ip, src_mac);
+                        arp_entry_t entry = {.probed = 0}, *old = map_get(&arp_table, arp_pkt->sender_ip);
+                        memcpy(entry.mac, src_mac, NET_MAC_LEN);
+                        if (!old || !old->permanent)  // 静态表项不被覆盖
+                            arp_entry_set(arp_pkt->sender_ip, &entry, net_now());
                         //调用 map_get() 函数查看该接收报文的 IP 地址是否有对应的 arp_buf 缓存。
-                        buf_t* buf = map_get(&arp_buf, arp_pkt->sender_ip);
-                        if (buf) {
-                            // 有缓存，把缓存包发出去，然后从map中删去
-                            ethernet_out(buf, arp_pkt->sender_mac, NET_PROTOCOL_IP);   // 这个数据包是来自IP层的
+                        arp_pending_t *pending = map_get(&arp_buf, arp_pkt->sender_ip);
+                        if (pending) {
+                            // 有缓存，按排队的顺序把缓存包发出去，然后从map中删去
+                            for (; pending->count; pending->count--) {
+                                buf_t *queued = &pending->bufs[pending->head];
+                                ethernet_out(queued, arp_pkt->sender_mac, NET_PROTOCOL_IP);   // 这个数据包是来自IP层的
+                                buf_unref(queued);
+                                pending->head = (pending->head + 1) % ARP_PENDING_MAX;
+                                arp_stats.pending_flushed++;
+                            }
                             map_delete(&arp_buf, arp_pkt->sender_ip);  // 删除缓存
 
                         } else {
@@ -160,33 +325,202 @@ void arp_in(buf_t *buf, uint8_t *src_mac) {
  * @param protocol 上层协议
  */
 void arp_out(buf_t *buf, uint8_t *ip) {
+    arp_out_cached(buf, ip, NULL);
+}
+
+/**
+ * @brief 处理一个要发送的数据包，先查调用者持有的下一跳缓存，命中则不查arp表
+ *
+ * @param buf 要处理的数据包
+ * @param ip 目标ip地址
+ * @param cache 下一跳缓存，查表命中时填入，为NULL则只查表
+ */
+void arp_out_cached(buf_t *buf, uint8_t *ip, arp_cache_t *cache) {
     // TO-DO
     // map是每个协议自己有自己的map
+    if (cache && cache->generation == arp_generation && net_now() < cache->valid_until && !memcmp(cache->ip, ip, NET_IP_LEN)) {
+        arp_stats.cache_hits++;
+        ethernet_out(buf, cache->mac, NET_PROTOCOL_IP);
+        return;
+    }
 
-    uint8_t * mac;
-    mac = (uint8_t*)map_get(&arp_table, ip);  // 查表
+    arp_entry_t *entry;
+    arp_pending_t *pending;
+    time_t updated;
+    entry = map_get_time(&arp_table, ip, &updated);  // 查表
     // 根据结果是否查到
-    if (mac) {
-        ethernet_out(buf, mac, NET_PROTOCOL_IP);  // 如果查到，直接发送
-    } else if (map_get(&arp_buf, ip)) {
-        // 如果查buf表有包，此时不能再发送 ARP 请求
-        return;
+    if (entry) {
+        // 快要过期的表项仍在使用，单播探测刷新，等待响应期间照常使用旧的mac地址，不会因为重新解析而中断发送
+        ethernet_out(buf, entry->mac, NET_PROTOCOL_IP);  // 如果查到，直接发送
+        time_t now = net_now();
+        if (!entry->permanent && now - updated >= (ARP_TIMEOUT_SEC - ARP_REFRESH_SEC) * 1000 && (!entry->probed || now - entry->probed >= ARP_MIN_INTERVAL * 1000)) {
+            entry->probed = now;
+            arp_stats.refresh_probes++;
+            arp_probe(ip, entry->mac);  // 数据包可能就在txbuf中，须先发出再探测
+        } else if (cache) {
+            memcpy(cache->ip, ip, NET_IP_LEN);
+            memcpy(cache->mac, entry->mac, NET_MAC_LEN);
+            cache->generation = arp_generation;
+            cache->valid_until = (entry->permanent ? now : updated) + (ARP_TIMEOUT_SEC - ARP_REFRESH_SEC) * 1000;  // 静态表项不过期，也定期重新查表
+        }
+    } else if ((pending = map_get(&arp_buf, ip))) {
+        // 如果查buf表有包，说明已发过 ARP 请求，此时不能再发送，数据包排到队尾，由定时器负责重发请求
+        if (pending->unreachable) {  // 处于负缓存中，到期前不重新解析
+            arp_stats.negative_drops++;
+            return;
+        }
+        if (pending->count == ARP_PENDING_MAX) {
+            arp_stats.pending_overflow++;
+            return;
+        }
+        buf_ref(&pending->bufs[(pending->head + pending->count) % ARP_PENDING_MAX], buf, 0);
+        pending->count++;
+        arp_stats.pending_queued++;
     } else {
         // 否则则调用 map_set() 函数将来自 IP 层的数据包缓存到 arp_buf 中，
         // 然后调用 arp_req() 函数，发送一个请求目标 IP 地址对应的 MAC 地址的 ARP request 报文。
-        map_set(&arp_buf, ip, buf);  // 设置buf表
-        arp_req(ip);
+        arp_pending_t queue = {.count = 1};
+        buf_ref(&queue.bufs[0], buf, 0);  // 共享数据包的存储块，不拷贝
+        if (map_set(&arp_buf, ip, &queue) < 0) {  // 设置buf表
+            buf_unref(&queue.bufs[0]);
+            arp_stats.pending_overflow++;
+            return;
+        }
+        arp_stats.pending_queued++;
+        arp_pending_request(ip, map_get(&arp_buf, ip));
     }
 
 }
 
+/**
+ * @brief arp表的永不超时判断，静态表项永不过期
+ *
+ * @param value 表项
+ * @return int 静态表项为1
+ */
+static int arp_entry_permanent(const void *value) {
+    return ((const arp_entry_t *)value)->permanent;
+}
+
+/**
+ * @brief 定期清理超时的arp表项
+ *
+ */
+static timer_event_t arp_expire_timer;
+
+static void arp_expire(void *arg) {
+    map_foreach(&arp_table, NULL);
+    timer_add(&arp_expire_timer, ARP_MIN_INTERVAL * 1000);
+}
+
 /**
  * @brief 初始化arp协议
  *
  */
 void arp_init() {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, NULL, buf_copy);
+    map_init(&arp_table, NET_IP_LEN, sizeof(arp_entry_t), 0, ARP_TIMEOUT_SEC, NULL, NULL, NULL, NULL, arp_entry_permanent);
+    arp_generation++;  // 重新初始化前填入的缓存全部失效
+    map_init(&arp_buf, NET_IP_LEN, sizeof(arp_pending_t), 0, 0, NULL, NULL, NULL, arp_pending_free, NULL);  // 由arp_retry负责清理
+    memset(&arp_stats, 0, sizeof(arp_stats));
+    arp_bucket.updated = net_now();
+    arp_bucket.tokens = ARP_BROADCAST_BURST * 1000;
+    timer_setup(&arp_retry_timer, arp_retry, NULL);
+    timer_setup(&arp_expire_timer, arp_expire, NULL);
+    timer_add(&arp_expire_timer, ARP_MIN_INTERVAL * 1000);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
+    arp_load(ARP_CACHE_FILE, 0);   // 上次关闭时学到的表项，启动后即可直接发送
+    arp_load(ARP_STATIC_FILE, 1);  // 后载入，覆盖同一地址上学到的表项
     arp_req(net_if_ip);
+}
+
+/**
+ * @brief 从文件载入arp表项，每行“ip mac [更新时间]”，mac以:或-分隔，#开始注释。文件不存在时什么也不做。
+ * 带更新时间（日历时间的秒数，arp_save写出）的表项保留原来的年龄，已过期的不载入，快过期的第一次使用时即探测刷新
+ *
+ * @param path 文件路径，为NULL则什么也不做
+ * @param permanent 为1则载入为永不过期的静态表项，忽略更新时间
+ * @return int 载入的表项数
+ */
+int arp_load(const char *path, int permanent) {
+    FILE *f = path ? fopen(path, "r") : NULL;
+    if (!f)
+        return 0;
+    char line[256];
+    int n = 0;
+    for (int lineno = 1; fgets(line, sizeof(line), f); lineno++) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0')  // 空行
+            continue;
+        uint8_t ip[NET_IP_LEN];
+        arp_entry_t entry = {.permanent = permanent};
+        int end = -1;
+        long long updated = -1;
+        char rest;
+        int fields = sscanf(line, " %hhu.%hhu.%hhu.%hhu %hhx%*1[:-]%hhx%*1[:-]%hhx%*1[:-]%hhx%*1[:-]%hhx%*1[:-]%hhx%n",
+                            &ip[0], &ip[1], &ip[2], &ip[3], &entry.mac[0], &entry.mac[1], &entry.mac[2], &entry.mac[3], &entry.mac[4], &entry.mac[5], &end);
+        int extra = end < 0 ? 0 : sscanf(line + end, "%lld %c", &updated, &rest);  // 没有更新时间时为EOF
+        if (fields != NET_IP_LEN + NET_MAC_LEN || (extra != EOF && extra != 1)) {
+            fprintf(stderr, "Error in arp_load: %s:%d malformed entry.\n", path, lineno);
+            continue;
+        }
+        time_t now = net_now();
+        if (!permanent && updated >= 0) {
+            time_t age = time(NULL) - updated;
+            if (age >= ARP_TIMEOUT_SEC)  // 关闭期间已过期
+                continue;
+            if (age > 0)
+                now -= age * 1000;
+        }
+        if (arp_entry_set(ip, &entry, now) < 0) {
+            fprintf(stderr, "Error in arp_load: arp table full.\n");
+            break;
+        }
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static FILE *arp_save_f;  // arp_save正在写的文件
+
+/**
+ * @brief 内部函数，写出一条学到的arp表项及其更新时间（换算为日历时间），下次载入时保留年龄
+ *
+ * @param ip 表项的ip地址
+ * @param value 表项
+ * @param timestamp 表项的更新时间
+ */
+static void arp_entry_save(void *ip, void *value, time_t *timestamp) {
+    arp_entry_t *entry = value;
+    if (!entry->permanent)  // 静态表项以配置文件为准
+        fprintf(arp_save_f, "%s %s %lld\n", iptos(ip), mactos(entry->mac), (long long)(time(NULL) - (net_now() - *timestamp) / 1000));
+}
+
+/**
+ * @brief 把学到的arp表项（不含静态表项）保存到文件，格式与arp_load一致，供下次启动时载入
+ *
+ * @param path 文件路径，为NULL则什么也不做
+ * @return int 成功为0，失败为-1
+ */
+int arp_save(const char *path) {
+    if (!path)
+        return 0;
+    arp_save_f = fopen(path, "w");
+    if (!arp_save_f) {
+        fprintf(stderr, "Error in arp_save: cannot open %s.\n", path);
+        return -1;
+    }
+    map_foreach(&arp_table, arp_entry_save);
+    fclose(arp_save_f);
+    arp_save_f = NULL;
+    return 0;
+}
+
+/**
+ * @brief 获取arp的统计
+ *
+ * @return const arp_stats_t* 统计信息
+ */
+const arp_stats_t *arp_get_stats() {
+    return &arp_stats;
 }
\ No newline at end of file
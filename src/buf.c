@@ -1,22 +1,184 @@
 #include "buf.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+
+/**
+ * @brief 缓冲池中的存储块，空闲时通过next串成所属大小类的空闲链表
+ *
+ */
+struct buf_block {
+    buf_block_t *next;  // 空闲链表中的下一块
+    uint32_t refs;      // 引用计数，即共享该块的buffer个数
+    uint8_t cls;        // 所属大小类
+    uint8_t payload[];  // 存储空间，容量为所属大小类的块容量
+};
+
+/**
+ * @brief 各大小类的空闲链表
+ *
+ */
+static buf_block_t *buf_free_list[BUF_CLASS_NUM];
+
+/**
+ * @brief 各大小类的块容量及使用统计，按块容量从小到大排列
+ *
+ */
+static buf_pool_stats_t buf_pool_stats[BUF_CLASS_NUM] = {
+    {.block_size = BUF_MTU_SIZE},
+    {.block_size = BUF_JUMBO_SIZE},
+    {.block_size = BUF_MAX_LEN},
+};
+
+/**
+ * @brief 从缓冲池中分配一个能容纳size字节的最小的块，空闲链表为空时一次向系统申请BUF_POOL_GROW块
+ *
+ * @param size 需要的容量
+ * @return buf_block_t* 分配的块，超过最大大小类或内存不足为NULL
+ */
+static buf_block_t *buf_block_alloc(size_t size) {
+    int cls = 0;
+    while (cls < BUF_CLASS_NUM && buf_pool_stats[cls].block_size < size)
+        cls++;
+    if (cls == BUF_CLASS_NUM)
+        return NULL;
+    buf_pool_stats_t *stats = &buf_pool_stats[cls];
+    if (buf_free_list[cls] == NULL) {
+        size_t block_len = (offsetof(buf_block_t, payload) + stats->block_size + 15) & ~(size_t)15;
+        uint8_t *mem = malloc(block_len * BUF_POOL_GROW);
+        if (mem == NULL)
+            return NULL;
+        for (int i = 0; i < BUF_POOL_GROW; i++) {
+            buf_block_t *block = (buf_block_t *)(mem + i * block_len);
+            block->cls = cls;
+            block->next = buf_free_list[cls];
+            buf_free_list[cls] = block;
+        }
+        stats->total += BUF_POOL_GROW;
+        stats->grows++;
+    }
+    buf_block_t *block = buf_free_list[cls];
+    buf_free_list[cls] = block->next;
+    block->refs = 1;
+    stats->allocs++;
+    if (++stats->in_use > stats->peak)
+        stats->peak = stats->in_use;
+    return block;
+}
+
+/**
+ * @brief 释放块的一个引用，没有引用时归还到所属大小类的空闲链表
+ *
+ * @param block 要释放的块
+ */
+static void buf_block_put(buf_block_t *block) {
+    if (--block->refs)
+        return;
+    block->next = buf_free_list[block->cls];
+    buf_free_list[block->cls] = block;
+    buf_pool_stats[block->cls].in_use--;
+}
+
+/**
+ * @brief 获取块的容量
+ *
+ * @param block 块
+ * @return size_t 容量
+ */
+static inline size_t buf_block_size(const buf_block_t *block) {
+    return buf_pool_stats[block->cls].block_size;
+}
+
 /**
- * @brief 初始化buffer为给定的长度，用于装载数据包
+ * @brief 判断buffer的块是否与其他buffer共享
  *
- * @param buf 要初始化的buffer
+ * @param buf 要判断的buffer
+ * @return int 共享为1，否则为0
+ */
+static inline int buf_shared(const buf_t *buf) {
+    return buf->block && buf->block->refs > 1;
+}
+
+/**
+ * @brief 释放buffer的第二段数据
+ *
+ * @param buf 要处理的buffer
+ */
+static void buf_slice_put(buf_t *buf) {
+    if (buf->slice_block)
+        buf_block_put(buf->slice_block);
+    buf->slice = NULL;
+    buf->slice_len = 0;
+    buf->slice_block = NULL;
+}
+
+/**
+ * @brief 确保buffer的数据位于自己独占的块中，且前后至少有head和tail字节的空间，否则换到更大的块。
+ * 数据前已有的内容（如刚去掉的协议头）一并保留。块被共享时总是换到新块（写时复制）
+ *
+ * @param buf 要处理的buffer
+ * @param head 需要的头部空间
+ * @param tail 需要的尾部空间
+ * @return int 成功为0，失败为-1
+ */
+static int buf_reserve(buf_t *buf, size_t head, size_t tail) {
+    size_t old_head = 0;
+    if (buf->borrowed)
+        old_head = buf->data - buf->borrowed;
+    else if (buf->block) {
+        old_head = buf->data - buf->block->payload;
+        if (!buf_shared(buf) && old_head >= head && buf_block_size(buf->block) - old_head - buf->len >= tail)
+            return 0;
+    }
+    if (head < old_head)
+        head = old_head;
+    if (head < BUF_HEADROOM)
+        head = BUF_HEADROOM;
+    if (tail < BUF_TAILROOM)
+        tail = BUF_TAILROOM;
+
+    buf_block_t *block = buf->block;
+    if (!buf->borrowed || !block || buf_shared(buf) || buf_block_size(block) < head + buf->len + tail)  // 借用外部内存时可直接复用已有的独占块
+        if ((block = buf_block_alloc(head + buf->len + tail)) == NULL)
+            return -1;
+    uint8_t *data = block->payload + head;
+    if (old_head + buf->len)
+        memcpy(data - old_head, buf->data - old_head, old_head + buf->len);
+    if (buf->block && buf->block != block)
+        buf_block_put(buf->block);
+    buf->block = block;
+    buf->data = data;
+    buf->borrowed = NULL;
+    return 0;
+}
+
+/**
+ * @brief 初始化buffer为给定的长度，用于装载数据包。
+ * 已有的块独占且够用则复用，否则从缓冲池中按大小类分配，数据前后预留BUF_HEADROOM和BUF_TAILROOM
+ *
+ * @param buf 要初始化的buffer，须已零初始化或使用过
  * @param len 数据初始长度
  * @return int 成功为0，失败为-1
  */
 int buf_init(buf_t *buf, size_t len) {
-    if (len >= BUF_MAX_LEN / 2) {
-        fprintf(stderr, "Error in buf_init:%zu\n", len);
-        return -1;
+    buf_slice_put(buf);
+    size_t size = BUF_HEADROOM + len + BUF_TAILROOM;
+    if (!buf->block || buf_shared(buf) || buf_block_size(buf->block) < size) {
+        buf_block_t *block = buf_block_alloc(size);
+        if (block == NULL) {
+            fprintf(stderr, "Error in buf_init:%zu\n", len);
+            return -1;
+        }
+        if (buf->block)
+            buf_block_put(buf->block);
+        buf->block = block;
     }
 
     buf->len = len;
-    buf->data = buf->payload + BUF_MAX_LEN / 2 - len;
+    buf->data = buf->block->payload + BUF_HEADROOM;
+    buf->borrowed = NULL;
+    buf->flags = 0;
     return 0;
 }
 
@@ -28,15 +190,16 @@ int buf_init(buf_t *buf, size_t len) {
  * @return int 成功为0，失败为-1
  */
 int buf_add_header(buf_t *buf, size_t len) {
-    if (buf->data - len < buf->payload) {
-        fprintf(stderr, "Error in buf_add_header:%zu+%zu\n", buf->len, len);
-        return -1;
+    if (buf->borrowed ? (size_t)(buf->data - buf->borrowed) < len : (!buf->block || buf_shared(buf) || (size_t)(buf->data - buf->block->payload) < len)) {
+        if (buf_reserve(buf, len, 0) < 0) {
+            fprintf(stderr, "Error in buf_add_header:%zu+%zu\n", buf->len, len);
+            return -1;
+        }
     }
     buf->len += len;
     buf->data -= len;
     return 0;
 }
-
 /**
  * @brief 为buffer在头部减少一段长度，去除协议头
  *
@@ -62,9 +225,13 @@ int buf_remove_header(buf_t *buf, size_t len) {
  * @return int 成功为0，失败为-1
  */
 int buf_add_padding(buf_t *buf, size_t len) {
-    if (buf->data + buf->len + len >= buf->payload + BUF_MAX_LEN) {
-        fprintf(stderr, "Error in buf_add_padding:%zu+%zu\n", buf->len, len);
+    if (buf->slice && buf_linearize(buf) < 0)  // 填充要接在第二段数据之后
         return -1;
+    if (buf->borrowed ? buf->data + buf->len + len > buf->borrowed + buf->borrowed_len : (!buf->block || buf_shared(buf) || buf->data + buf->len + len > buf->block->payload + buf_block_size(buf->block))) {
+        if (buf_reserve(buf, 0, len) < 0) {
+            fprintf(stderr, "Error in buf_add_padding:%zu+%zu\n", buf->len, len);
+            return -1;
+        }
     }
     memset(buf->data + buf->len, 0, len);
     buf->len += len;
@@ -79,16 +246,18 @@ int buf_add_padding(buf_t *buf, size_t len) {
  * @return int 成功为0，失败为-1
  */
 int buf_remove_padding(buf_t *buf, size_t len) {
-    if (buf->len < len) {
-        fprintf(stderr, "Error in buf_remove_padding:%zu-%zu\n", buf->len, len);
+    if (buf->len + buf->slice_len < len) {
+        fprintf(stderr, "Error in buf_remove_padding:%zu-%zu\n", buf->len + buf->slice_len, len);
         return -1;
     }
-    buf->len -= len;
+    size_t cut = len < buf->slice_len ? len : buf->slice_len;  // 先从第二段数据的末尾去除
+    buf->slice_len -= cut;
+    buf->len -= len - cut;
     return 0;
 }
 
 /**
- * @brief buf拷贝构造函数
+ * @brief buf拷贝构造函数，目的buffer视为未初始化，只拷贝有效数据
  *
  * @param pdst 目的buffer
  * @param psrc 源buffer
@@ -97,6 +266,151 @@ int buf_remove_padding(buf_t *buf, size_t len) {
 void buf_copy(void *pdst, const void *psrc, size_t len) {
     buf_t *dst = pdst;
     const buf_t *src = psrc;
-    buf_init(dst, src->len);
-    memcpy(dst->payload, src->payload, BUF_MAX_LEN);
+    memset(dst, 0, sizeof(buf_t));
+    if (buf_init(dst, src->len + src->slice_len) < 0)
+        return;
+    memcpy(dst->data, src->data, src->len);
+    if (src->slice_len)
+        memcpy(dst->data + src->len, src->slice, src->slice_len);
+    dst->flags = src->flags;
+    dst->csum = src->csum;
+    dst->csum_len = src->csum_len;
+}
+
+/**
+ * @brief 让buffer借用外部内存（如驱动的接收缓冲区）装载数据包，不拷贝数据，
+ * 外部内存须在buffer使用期间保持有效。buffer已有的块保留，供之后的buf_detach复用
+ *
+ * @param buf 要设置的buffer
+ * @param data 外部内存起始地址，即数据包起始地址
+ * @param len 数据包长度
+ */
+void buf_borrow(buf_t *buf, uint8_t *data, size_t len) {
+    buf_slice_put(buf);
+    buf->borrowed = data;
+    buf->borrowed_len = len;
+    buf->data = data;
+    buf->len = len;
+    buf->flags = 0;
+}
+
+/**
+ * @brief 将借用外部内存的buffer拷贝到自己的块中，
+ * 用于需要越过外部内存边界添加头部/填充或需要保留数据包的场景
+ *
+ * @param buf 要处理的buffer
+ * @return int 成功为0，失败为-1
+ */
+int buf_detach(buf_t *buf) {
+    if (!buf->borrowed)
+        return 0;
+    if (buf_reserve(buf, 0, 0) < 0) {
+        fprintf(stderr, "Error in buf_detach:%zu\n", buf->borrowed_len);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief buf引用构造函数，目的buffer视为未初始化，与源buffer共享同一个块而不拷贝数据。
+ * 共享的块中的数据应视为只读，添加头部/填充时会先复制出独占的块。
+ * 源buffer或其第二段数据借用外部内存时无法共享，退化为buf_copy
+ *
+ * @param pdst 目的buffer
+ * @param psrc 源buffer
+ * @param len 占位用，与memcpy保持形式一致，无意义
+ */
+void buf_ref(void *pdst, const void *psrc, size_t len) {
+    buf_t *dst = pdst;
+    const buf_t *src = psrc;
+    if (src->borrowed || !src->block || (src->slice && !src->slice_block)) {
+        buf_copy(dst, src, len);
+        return;
+    }
+    *dst = *src;
+    src->block->refs++;
+    if (src->slice_block)
+        src->slice_block->refs++;
+}
+
+/**
+ * @brief 释放buffer对其块的引用，最后一个引用释放时块归还缓冲池，之后buffer可重新buf_init
+ *
+ * @param buf 要释放的buffer
+ */
+void buf_unref(buf_t *buf) {
+    if (buf->block)
+        buf_block_put(buf->block);
+    buf_slice_put(buf);
+    buf->block = NULL;
+    buf->borrowed = NULL;
+    buf->data = NULL;
+    buf->len = 0;
+}
+
+/**
+ * @brief 初始化buffer为一段空的数据加上源buffer中的一段切片，不拷贝切片。
+ * 之后可在头部添加协议头，驱动后端发送时把两段数据依次发出（分散聚合）
+ *
+ * @param buf 要初始化的buffer，须已零初始化或使用过
+ * @param src 源buffer，切片共享其块；借用外部内存时须在发送完成前保持有效
+ * @param offset 切片在源buffer数据中的偏移
+ * @param len 切片长度
+ * @return int 成功为0，失败为-1
+ */
+int buf_slice(buf_t *buf, const buf_t *src, size_t offset, size_t len) {
+    if (offset + len > src->len) {
+        fprintf(stderr, "Error in buf_slice:%zu+%zu>%zu\n", offset, len, src->len);
+        return -1;
+    }
+    if (buf_init(buf, 0) < 0)
+        return -1;
+    buf->slice = src->data + offset;
+    buf->slice_len = len;
+    buf->slice_block = src->borrowed ? NULL : src->block;
+    if (buf->slice_block)
+        buf->slice_block->refs++;
+    return 0;
+}
+
+/**
+ * @brief 把buffer的第二段数据拷贝到第一段末尾，用于不支持分散聚合的驱动后端或需要修改数据的场景
+ *
+ * @param buf 要处理的buffer
+ * @return int 成功为0，失败为-1
+ */
+int buf_linearize(buf_t *buf) {
+    if (!buf->slice)
+        return 0;
+    buf_t slice = {.slice = buf->slice, .slice_len = buf->slice_len, .slice_block = buf->slice_block};
+    buf->slice = NULL;  // 先摘下，buf_add_padding不再递归
+    buf->slice_len = 0;
+    buf->slice_block = NULL;
+    if (buf_add_padding(buf, slice.slice_len) < 0) {
+        fprintf(stderr, "Error in buf_linearize:%zu+%zu\n", buf->len, slice.slice_len);
+        buf_slice_put(&slice);
+        return -1;
+    }
+    memcpy(buf->data + buf->len - slice.slice_len, slice.slice, slice.slice_len);
+    buf_slice_put(&slice);
+    return 0;
+}
+
+/**
+ * @brief 获取buffer持有的块的容量，即它实际占用的缓冲池内存
+ *
+ * @param buf 要查询的buffer
+ * @return size_t 块容量，没有块时为0
+ */
+size_t buf_capacity(const buf_t *buf) {
+    return buf->block ? buf_block_size(buf->block) : 0;
+}
+
+/**
+ * @brief 获取缓冲池的使用统计
+ *
+ * @return const buf_pool_stats_t* 各大小类的统计，共BUF_CLASS_NUM项
+ */
+const buf_pool_stats_t *buf_get_pool_stats() {
+    return buf_pool_stats;
 }
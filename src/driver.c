@@ -1,6 +1,14 @@
+#if !defined(DRIVER_AF_PACKET) && !defined(DRIVER_TAP)
+#ifdef __linux__
+#define _GNU_SOURCE  // sendmmsg
+#endif
 #include "driver.h"
 
 #include <pcap.h>
+#ifdef __linux__
+#include <errno.h>
+#include <sys/socket.h>
+#endif
 
 #ifdef _WIN32
 #include <tchar.h>
@@ -29,6 +37,27 @@ BOOL LoadNpcapDlls() {
 pcap_t *pcap;
 char pcap_errbuf[PCAP_ERRBUF_SIZE];
 
+#if defined(_WIN32)
+/**
+ * @brief 发送队列，使用npcap的sendqueue一次提交
+ *
+ */
+static pcap_send_queue *driver_tx_queue;
+static int driver_tx_count;
+#elif defined(__linux__)
+/**
+ * @brief 发送队列，帧拷贝到连续的缓冲区中，使用sendmmsg一次提交
+ *
+ */
+static struct {
+    uint8_t data[DRIVER_TX_BATCH * (ETHERNET_MAX_TRANSPORT_UNIT + 14)];  // 排队帧的拷贝
+    size_t used;                                                         // data中已使用的字节数
+    int count;                                                           // 排队的帧数
+    struct iovec iovs[DRIVER_TX_BATCH];                                  // 每帧的数据位置
+    struct mmsghdr msgs[DRIVER_TX_BATCH];                                // sendmmsg参数
+} driver_tx;
+#endif
+
 /**
  * @brief 根据ip进行前缀匹配，选取最长前缀匹配的网卡
  *
@@ -107,9 +136,16 @@ int driver_open() {
     }
     printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_if_ip));
 
-    if ((pcap = pcap_open_live(if_name, 65536, 1, 10, pcap_errbuf)) == NULL)  // 混杂模式打开网卡
-    {
-        fprintf(stderr, "Error in pcap_open_live.\n%s.\n", pcap_errbuf);
+    if ((pcap = pcap_create(if_name, pcap_errbuf)) == NULL) {
+        fprintf(stderr, "Error in pcap_create.\n%s.\n", pcap_errbuf);
+        return -1;
+    }
+    pcap_set_snaplen(pcap, 65536);
+    pcap_set_promisc(pcap, 1);  // 混杂模式打开网卡
+    pcap_set_timeout(pcap, 10);
+    pcap_set_immediate_mode(pcap, 1);  // 数据包到达即唤醒阻塞在driver_fd上的事件循环，不等缓冲区攒满
+    if (pcap_activate(pcap) < 0) {
+        fprintf(stderr, "Error in pcap_activate.\n%s.\n", pcap_geterr(pcap));
         return -1;
     }
     if (pcap_setnonblock(pcap, 1, pcap_errbuf) < 0)  // 设置非阻塞模式
@@ -142,6 +178,12 @@ int driver_open() {
         fprintf(stderr, "Error in pcap_setfilter.\n%s.\n", pcap_geterr(pcap));
         return -1;
     }
+#ifdef _WIN32
+    if ((driver_tx_queue = pcap_sendqueue_alloc(DRIVER_TX_BATCH * (ETHERNET_MAX_TRANSPORT_UNIT + 14 + sizeof(struct pcap_pkthdr)))) == NULL) {
+        fprintf(stderr, "Error in pcap_sendqueue_alloc.\n");
+        return -1;
+    }
+#endif
     return 0;
 }
 /**
@@ -157,20 +199,71 @@ int driver_recv(buf_t *buf) {
     if (ret == 0)
         return 0;
     else if (ret == 1) {
+        buf_init(buf, pkt_hdr->len);
         memcpy(buf->data, pkt_data, pkt_hdr->len);
-        buf->len = pkt_hdr->len;
         return pkt_hdr->len;
     }
     fprintf(stderr, "Error in driver_recv.\n%s.\n", pcap_geterr(pcap));
     return -1;
 }
+
+/**
+ * @brief 批量接收使用的驱动侧缓冲区，借用pcap的数据包内存
+ *
+ */
+static buf_t driver_rx_buf;
+
+/**
+ * @brief 批量接收的上下文，在pcap_dispatch回调中使用
+ *
+ */
+typedef struct driver_batch {
+    driver_handler_t handler;  // 每个数据包的处理程序
+    int count;                 // 已处理的数据包个数
+} driver_batch_t;
+
+/**
+ * @brief pcap_dispatch的回调，借用数据包内存直接交给处理程序。
+ * 内存只在回调返回前有效，所以在这里处理而不是交回给调用者
+ *
+ * @param user 批量接收的上下文
+ * @param pkt_hdr 数据包的pcap头
+ * @param pkt_data 数据包内容
+ */
+static void driver_batch_handler(u_char *user, const struct pcap_pkthdr *pkt_hdr, const u_char *pkt_data) {
+    driver_batch_t *batch = (driver_batch_t *)user;
+    buf_borrow(&driver_rx_buf, (uint8_t *)pkt_data, pkt_hdr->caplen);
+    batch->handler(&driver_rx_buf);
+    batch->count++;
+}
+
 /**
- * @brief 使用网卡发送一个数据包
+ * @brief 试图从网卡一次接收并处理多个数据包，一次pcap_dispatch取出一批，不做拷贝
+ *
+ * @param handler 每个数据包的处理程序，数据包借用pcap的内存，只在处理程序返回前有效
+ * @param max 最多接收的数据包个数
+ * @return int 收到的数据包个数，未收到为0，错误为-1
+ */
+int driver_recv_batch(driver_handler_t handler, int max) {
+    driver_batch_t batch = {.handler = handler, .count = 0};
+    if (max <= 0)
+        return 0;
+    int ret = pcap_dispatch(pcap, max, driver_batch_handler, (u_char *)&batch);
+    if (ret < 0 && ret != PCAP_ERROR_BREAK) {
+        fprintf(stderr, "Error in driver_recv_batch.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    return batch.count;
+}
+/**
+ * @brief 立即使用网卡发送一个数据包，不经过发送队列
  *
  * @param buf 要发送的数据包
  * @return int 成功为0，失败为-1
  */
-int driver_send(buf_t *buf) {
+static int driver_send_now(buf_t *buf) {
+    if (buf_linearize(buf) < 0)
+        return -1;
     if (pcap_sendpacket(pcap, buf->data, buf->len) == -1) {
         fprintf(stderr, "Error in driver_send.\n%s.\n", pcap_geterr(pcap));
         return -1;
@@ -178,10 +271,124 @@ int driver_send(buf_t *buf) {
 
     return 0;
 }
+
+/**
+ * @brief 使用网卡发送一个数据包。数据包被拷贝进发送队列，
+ * 队列积累到DRIVER_TX_BATCH帧或放不下时批量发出，其余的由driver_flush发出
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf) {
+#if defined(_WIN32)
+    if (buf_linearize(buf) < 0)
+        return -1;
+    struct pcap_pkthdr hdr = {0};
+    hdr.caplen = hdr.len = buf->len;
+    if (pcap_sendqueue_queue(driver_tx_queue, &hdr, buf->data) < 0) {
+        if (driver_flush() < 0 || pcap_sendqueue_queue(driver_tx_queue, &hdr, buf->data) < 0)
+            return driver_send_now(buf);
+    }
+    if (++driver_tx_count >= DRIVER_TX_BATCH)
+        return driver_flush();
+    return 0;
+#elif defined(__linux__)
+    size_t len = buf->len + buf->slice_len;
+    if (len > sizeof(driver_tx.data) - driver_tx.used && driver_flush() < 0)
+        return -1;
+    if (len > sizeof(driver_tx.data) - driver_tx.used)  // 超大帧直接发送
+        return driver_send_now(buf);
+    uint8_t *frame = driver_tx.data + driver_tx.used;
+    memcpy(frame, buf->data, buf->len);  // 分散聚合的两段数据在这里拼成一帧，不需要先合并
+    if (buf->slice_len)
+        memcpy(frame + buf->len, buf->slice, buf->slice_len);
+    driver_tx.used += len;
+    driver_tx.iovs[driver_tx.count].iov_base = frame;
+    driver_tx.iovs[driver_tx.count].iov_len = len;
+    driver_tx.count++;
+    if (driver_tx.count >= DRIVER_TX_BATCH)
+        return driver_flush();
+    return 0;
+#else
+    return driver_send_now(buf);
+#endif
+}
+
+/**
+ * @brief 将发送队列中的数据包一次全部发出
+ *
+ * @return int 成功为0，失败为-1，失败时队列中剩余的数据包被丢弃
+ */
+int driver_flush() {
+#if defined(_WIN32)
+    if (driver_tx_count == 0)
+        return 0;
+    u_int len = driver_tx_queue->len;
+    u_int sent = pcap_sendqueue_transmit(pcap, driver_tx_queue, 0);
+    driver_tx_queue->len = 0;
+    driver_tx_count = 0;
+    if (sent < len) {
+        fprintf(stderr, "Error in driver_flush.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    return 0;
+#elif defined(__linux__)
+    int ret = 0, sent = 0;
+    int fd = pcap_get_selectable_fd(pcap);
+    for (int i = 0; i < driver_tx.count; i++) {
+        memset(&driver_tx.msgs[i], 0, sizeof(driver_tx.msgs[i]));
+        driver_tx.msgs[i].msg_hdr.msg_iov = &driver_tx.iovs[i];
+        driver_tx.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (sent < driver_tx.count) {
+        int n = sendmmsg(fd, driver_tx.msgs + sent, driver_tx.count - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error in driver_flush: %s\n", strerror(errno));
+            ret = -1;
+            break;
+        }
+        sent += n;
+    }
+    driver_tx.count = 0;
+    driver_tx.used = 0;
+    return ret;
+#else
+    return 0;
+#endif
+}
+/**
+ * @brief 查询驱动后端支持的卸载能力，pcap不支持任何卸载
+ *
+ * @return int DRIVER_OFFLOAD_*的组合
+ */
+int driver_offload() {
+    return 0;
+}
+
+/**
+ * @brief 获取可用于select/epoll等待数据包到达的文件描述符
+ *
+ * @return int 文件描述符，平台不支持（如Windows）为-1
+ */
+int driver_fd() {
+#ifdef _WIN32
+    return -1;
+#else
+    return pcap_get_selectable_fd(pcap);
+#endif
+}
+
 /**
  * @brief 关闭网卡
  *
  */
 void driver_close() {
+    driver_flush();
+#ifdef _WIN32
+    pcap_sendqueue_destroy(driver_tx_queue);
+#endif
     pcap_close(pcap);
 }
+#endif
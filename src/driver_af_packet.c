@@ -0,0 +1,367 @@
+#ifdef DRIVER_AF_PACKET
+/**
+ * Linux AF_PACKET驱动后端，使用TPACKET_V3内存映射环形缓冲区收发数据包，
+ * 与pcap后端实现相同的driver_open/recv/send/close接口。
+ * 构建时通过 cmake -DDRIVER=af_packet 选择。
+ *
+ * 可在本地veth对上测试：
+ *   ip link add veth0 type veth peer name veth1
+ *   ip addr add 10.250.217.1/16 dev veth0
+ *   ip link set veth0 up && ip link set veth1 up
+ *   sudo NET_IF_NAME=veth1 ./build/udp_server
+ * 之后即可在本机通过veth0访问协议栈的ip地址。
+ */
+#include "driver.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief AF_PACKET套接字及其环形缓冲区
+ *
+ */
+static struct {
+    int fd;                       // AF_PACKET套接字
+    uint8_t *map;                 // 接收环与发送环的映射起始地址
+    size_t map_len;               // 映射总长度
+    struct tpacket_req3 rx_req;   // 接收环参数
+    struct tpacket_req3 tx_req;   // 发送环参数
+    uint8_t *tx_ring;             // 发送环起始地址
+    unsigned int rx_block;        // 当前接收块
+    unsigned int rx_done;         // 第一个已读完但尚未归还内核的接收块
+    unsigned int rx_pkt_left;     // 当前接收块中未读取的数据包数
+    struct tpacket3_hdr *rx_pkt;  // 当前接收块中下一个数据包
+    unsigned int tx_frame;        // 下一个发送帧
+    unsigned int tx_pending;      // 已填入发送环但尚未通知内核发送的帧数
+} ring = {.fd = -1};
+
+/**
+ * @brief 根据ip进行前缀匹配，选取最长前缀匹配的网卡，可用环境变量NET_IF_NAME直接指定
+ *
+ * @param ip ip地址
+ * @param if_name 出口参数，选取的网卡名
+ * @return int 成功为0，失败为-1
+ */
+static int driver_find(uint8_t *ip, char *if_name) {
+    const char *env = getenv("NET_IF_NAME");
+    if (env && *env) {
+        snprintf(if_name, IF_NAMESIZE, "%s", env);
+        return 0;
+    }
+
+    struct ifaddrs *ifaddr, *ifa;
+    if (getifaddrs(&ifaddr) == -1) {
+        fprintf(stderr, "Error in getifaddrs: %s\n", strerror(errno));
+        return -1;
+    }
+    uint8_t max_match = 0;
+    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET || !ifa->ifa_netmask)
+            continue;
+        uint8_t *addr = (uint8_t *)&((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr;
+        uint8_t *mask = (uint8_t *)&((struct sockaddr_in *)ifa->ifa_netmask)->sin_addr.s_addr;
+        uint32_t mask_all = 0xFFFFFFFF;
+        uint8_t match = ip_prefix_match(ip, addr);
+        if (match < ip_prefix_match((uint8_t *)&mask_all, mask) || match <= max_match)
+            continue;
+        if (match == 32) {
+            fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", ifa->ifa_name, iptos(net_if_ip));
+            freeifaddrs(ifaddr);
+            return -1;
+        }
+        max_match = match;
+        snprintf(if_name, IF_NAMESIZE, "%s", ifa->ifa_name);
+    }
+    freeifaddrs(ifaddr);
+    if (max_match == 0) {
+        fprintf(stderr, "Error, no interface found.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 打开网卡
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_open() {
+    char if_name[IF_NAMESIZE];
+    if (driver_find(net_if_ip, if_name) < 0) {
+        fprintf(stderr, "Error in driver find.\n");
+        return -1;
+    }
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_if_ip));
+
+    if ((ring.fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) < 0) {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    int version = TPACKET_V3;
+    if (setsockopt(ring.fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        fprintf(stderr, "Error in setsockopt PACKET_VERSION: %s\n", strerror(errno));
+        goto err;
+    }
+
+    ring.rx_req.tp_block_size = DRIVER_RING_BLOCK_SIZE;
+    ring.rx_req.tp_block_nr = DRIVER_RX_RING_BLOCK_NUM;
+    ring.rx_req.tp_frame_size = DRIVER_RING_FRAME_SIZE;
+    ring.rx_req.tp_frame_nr = DRIVER_RING_BLOCK_SIZE / DRIVER_RING_FRAME_SIZE * DRIVER_RX_RING_BLOCK_NUM;
+    ring.rx_req.tp_retire_blk_tov = DRIVER_RING_BLOCK_TIMEOUT_MS;
+    if (setsockopt(ring.fd, SOL_PACKET, PACKET_RX_RING, &ring.rx_req, sizeof(ring.rx_req)) < 0) {
+        fprintf(stderr, "Error in setsockopt PACKET_RX_RING: %s\n", strerror(errno));
+        goto err;
+    }
+    ring.tx_req.tp_block_size = DRIVER_RING_BLOCK_SIZE;
+    ring.tx_req.tp_block_nr = DRIVER_TX_RING_BLOCK_NUM;
+    ring.tx_req.tp_frame_size = DRIVER_RING_FRAME_SIZE;
+    ring.tx_req.tp_frame_nr = DRIVER_RING_BLOCK_SIZE / DRIVER_RING_FRAME_SIZE * DRIVER_TX_RING_BLOCK_NUM;
+    if (setsockopt(ring.fd, SOL_PACKET, PACKET_TX_RING, &ring.tx_req, sizeof(ring.tx_req)) < 0) {
+        fprintf(stderr, "Error in setsockopt PACKET_TX_RING: %s\n", strerror(errno));
+        goto err;
+    }
+
+    size_t rx_len = (size_t)ring.rx_req.tp_block_size * ring.rx_req.tp_block_nr;
+    size_t tx_len = (size_t)ring.tx_req.tp_block_size * ring.tx_req.tp_block_nr;
+    ring.map_len = rx_len + tx_len;
+    ring.map = mmap(NULL, ring.map_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd, 0);
+    if (ring.map == MAP_FAILED) {
+        fprintf(stderr, "Error in mmap: %s\n", strerror(errno));
+        ring.map = NULL;
+        goto err;
+    }
+    ring.tx_ring = ring.map + rx_len;
+
+    struct sockaddr_ll sll = {0};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = if_nametoindex(if_name);
+    if (sll.sll_ifindex == 0 || bind(ring.fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        fprintf(stderr, "Error in bind %s: %s\n", if_name, strerror(errno));
+        goto err;
+    }
+    struct packet_mreq mreq = {0};  // 混杂模式打开网卡
+    mreq.mr_ifindex = sll.sll_ifindex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(ring.fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        fprintf(stderr, "Error in setsockopt PACKET_ADD_MEMBERSHIP: %s\n", strerror(errno));
+        goto err;
+    }
+    return 0;
+err:
+    driver_close();
+    return -1;
+}
+
+/**
+ * @brief 判断一个数据包是否应交给协议栈，与pcap后端的过滤规则一致
+ *
+ * @param data 以太网帧
+ * @param len 帧长度
+ * @return int 是为1，否为0
+ */
+static int driver_accept(const uint8_t *data, size_t len) {
+    static const uint8_t broadcast[NET_MAC_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (len < 2 * NET_MAC_LEN)
+        return 0;
+    if (memcmp(data, net_if_mac, NET_MAC_LEN) && memcmp(data, broadcast, NET_MAC_LEN))
+        return 0;
+    return memcmp(data + NET_MAC_LEN, net_if_mac, NET_MAC_LEN) != 0;
+}
+
+/**
+ * @brief 取出接收环中的下一个数据包，必要时跳到下一个块。
+ * 读完的块暂不归还内核，因为借出的数据包仍指向其中
+ *
+ * @return struct tpacket3_hdr* 数据包，没有可读的数据包为NULL
+ */
+static struct tpacket3_hdr *driver_ring_next() {
+    for (;;) {
+        struct tpacket_block_desc *block = (struct tpacket_block_desc *)(ring.map + (size_t)ring.rx_block * ring.rx_req.tp_block_size);
+        if (ring.rx_pkt == NULL) {
+            if (!(block->hdr.bh1.block_status & TP_STATUS_USER))
+                return NULL;
+            ring.rx_pkt_left = block->hdr.bh1.num_pkts;
+            ring.rx_pkt = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+        }
+        if (ring.rx_pkt_left > 0) {
+            struct tpacket3_hdr *pkt = ring.rx_pkt;
+            ring.rx_pkt_left--;
+            ring.rx_pkt = (struct tpacket3_hdr *)((uint8_t *)pkt + pkt->tp_next_offset);
+            return pkt;
+        }
+        unsigned int next = (ring.rx_block + 1) % ring.rx_req.tp_block_nr;
+        if (next == ring.rx_done)  // 整个环都未归还，等待下一次接收
+            return NULL;
+        ring.rx_pkt = NULL;
+        ring.rx_block = next;
+    }
+}
+
+/**
+ * @brief 将上一次接收中已读完的块归还给内核。
+ * 当前块若已读完也一并归还，否则空闲时内核会一直报告套接字可读，事件轮询退化为忙等
+ *
+ */
+static void driver_ring_release() {
+    if (ring.rx_pkt && ring.rx_pkt_left == 0) {
+        ring.rx_pkt = NULL;
+        ring.rx_block = (ring.rx_block + 1) % ring.rx_req.tp_block_nr;
+    }
+    while (ring.rx_done != ring.rx_block) {
+        struct tpacket_block_desc *block = (struct tpacket_block_desc *)(ring.map + (size_t)ring.rx_done * ring.rx_req.tp_block_size);
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring.rx_done = (ring.rx_done + 1) % ring.rx_req.tp_block_nr;
+    }
+}
+
+/**
+ * @brief 批量接收使用的驱动侧缓冲区，借用接收环中的帧内存
+ *
+ */
+static buf_t driver_rx_buf;
+
+/**
+ * @brief 试图从网卡一次接收并处理多个数据包，数据包直接借用接收环中的内存，不做拷贝
+ *
+ * @param handler 每个数据包的处理程序，数据包只在处理程序返回前有效
+ * @param max 最多接收的数据包个数
+ * @return int 收到的数据包个数，未收到为0，错误为-1
+ */
+int driver_recv_batch(driver_handler_t handler, int max) {
+    int count = 0;
+    struct tpacket3_hdr *pkt;
+    driver_ring_release();
+    while (count < max && (pkt = driver_ring_next()) != NULL) {
+        uint8_t *data = (uint8_t *)pkt + pkt->tp_mac;
+        if (!driver_accept(data, pkt->tp_snaplen))
+            continue;
+        buf_borrow(&driver_rx_buf, data, pkt->tp_snaplen);
+        handler(&driver_rx_buf);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief driver_recv的拷贝目标
+ *
+ */
+static buf_t *driver_recv_dst;
+
+/**
+ * @brief driver_recv使用的处理程序，把借用的数据包拷贝到调用者的buf中
+ *
+ * @param rx 收到的数据包
+ */
+static void driver_recv_copy(buf_t *rx) {
+    buf_init(driver_recv_dst, rx->len);
+    memcpy(driver_recv_dst->data, rx->data, rx->len);
+}
+
+/**
+ * @brief 试图从网卡接收数据包
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf) {
+    driver_recv_dst = buf;
+    if (driver_recv_batch(driver_recv_copy, 1) <= 0)
+        return 0;
+    return buf->len;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包。数据包填入发送环后暂不通知内核，
+ * 积累到DRIVER_TX_BATCH帧或发送环已满时一次send发出，其余的由driver_flush发出
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf) {
+    size_t data_off = TPACKET3_HDRLEN - sizeof(struct sockaddr_ll);
+    size_t len = buf->len + buf->slice_len;
+    if (len > ring.tx_req.tp_frame_size - data_off) {
+        fprintf(stderr, "Error in driver_send: frame too long %zu.\n", len);
+        return -1;
+    }
+    struct tpacket3_hdr *hdr = (struct tpacket3_hdr *)(ring.tx_ring + (size_t)ring.tx_frame * ring.tx_req.tp_frame_size);
+    if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+        driver_flush();
+        if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+            fprintf(stderr, "Error in driver_send: tx ring full.\n");
+            return -1;
+        }
+    }
+    memcpy((uint8_t *)hdr + data_off, buf->data, buf->len);  // 分散聚合的两段数据直接拷贝进发送环
+    if (buf->slice_len)
+        memcpy((uint8_t *)hdr + data_off + buf->len, buf->slice, buf->slice_len);
+    hdr->tp_len = len;
+    hdr->tp_snaplen = len;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    ring.tx_frame = (ring.tx_frame + 1) % ring.tx_req.tp_frame_nr;
+
+    if (++ring.tx_pending >= DRIVER_TX_BATCH)
+        return driver_flush();
+    return 0;
+}
+
+/**
+ * @brief 通知内核发出发送环中所有待发送的帧
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_flush() {
+    if (ring.tx_pending == 0)
+        return 0;
+    ring.tx_pending = 0;
+    if (send(ring.fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "Error in driver_flush: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 查询驱动后端支持的卸载能力，AF_PACKET环形缓冲区不携带virtio-net头，不支持卸载
+ *
+ * @return int DRIVER_OFFLOAD_*的组合
+ */
+int driver_offload() {
+    return 0;
+}
+
+/**
+ * @brief 获取可用于select/epoll等待数据包到达的文件描述符
+ *
+ * @return int 文件描述符，未打开为-1
+ */
+int driver_fd() {
+    return ring.fd;
+}
+
+/**
+ * @brief 关闭网卡
+ *
+ */
+void driver_close() {
+    if (ring.fd >= 0)
+        driver_flush();
+    if (ring.map)
+        munmap(ring.map, ring.map_len);
+    if (ring.fd >= 0)
+        close(ring.fd);
+    ring.map = NULL;
+    ring.fd = -1;
+    ring.tx_pending = 0;
+}
+#endif
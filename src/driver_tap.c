@@ -0,0 +1,274 @@
+#ifdef DRIVER_TAP
+/**
+ * Linux TAP驱动后端，通过/dev/net/tun收发以太网帧，并打开IFF_VNET_HDR，
+ * 每个帧前带一个virtio-net头：接收时得知内核是否已校验过校验和，
+ * 发送时可把传输层校验和计算以及超过MTU的TCP/UDP大包分段交给内核完成。
+ * 与pcap后端实现相同的driver_open/recv/send/close接口，构建时通过 cmake -DDRIVER=tap 选择。
+ *
+ * 可在本地TAP设备上测试：
+ *   ip tuntap add dev tap0 mode tap
+ *   ip addr add 10.250.217.1/16 dev tap0
+ *   ip link set tap0 up
+ *   sudo NET_IF_NAME=tap0 ./build/udp_server
+ * 之后即可在本机通过tap0访问协议栈的ip地址。未指定NET_IF_NAME时使用DRIVER_TAP_DEFAULT_NAME。
+ */
+#include "driver.h"
+
+#include "ip.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define DRIVER_TAP_FRAME_MAX (sizeof(struct virtio_net_hdr) + 14 + UINT16_MAX)  // 一次read的最大长度，内核TSO的大包也能装下
+
+/**
+ * @brief TAP设备
+ *
+ */
+static struct {
+    int fd;       // /dev/net/tun文件描述符
+    int offload;  // 协商得到的卸载能力，DRIVER_OFFLOAD_*的组合
+} tap = {.fd = -1};
+
+/**
+ * @brief 依次尝试的卸载组合，内核可能已不支持UFO
+ *
+ */
+static const struct {
+    unsigned int tun_flags;  // TUNSETOFFLOAD参数
+    int offload;             // 对应的DRIVER_OFFLOAD_*组合
+} driver_tap_offloads[] = {
+    {TUN_F_CSUM | TUN_F_TSO4 | TUN_F_UFO, DRIVER_OFFLOAD_CSUM | DRIVER_OFFLOAD_TSO | DRIVER_OFFLOAD_UFO},
+    {TUN_F_CSUM | TUN_F_TSO4, DRIVER_OFFLOAD_CSUM | DRIVER_OFFLOAD_TSO},
+    {TUN_F_CSUM, DRIVER_OFFLOAD_CSUM},
+    {0, 0},
+};
+
+/**
+ * @brief 打开网卡
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_open() {
+    const char *if_name = getenv("NET_IF_NAME");
+    if (!if_name || !*if_name)
+        if_name = DRIVER_TAP_DEFAULT_NAME;
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_if_ip));
+
+    if ((tap.fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0) {  // 设置非阻塞模式
+        fprintf(stderr, "Error in open /dev/net/tun: %s\n", strerror(errno));
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+    snprintf(ifr.ifr_name, IF_NAMESIZE, "%s", if_name);
+    if (ioctl(tap.fd, TUNSETIFF, &ifr) < 0) {
+        fprintf(stderr, "Error in ioctl TUNSETIFF %s: %s\n", if_name, strerror(errno));
+        goto err;
+    }
+    int hdr_len = sizeof(struct virtio_net_hdr);
+    if (ioctl(tap.fd, TUNSETVNETHDRSZ, &hdr_len) < 0) {
+        fprintf(stderr, "Error in ioctl TUNSETVNETHDRSZ: %s\n", strerror(errno));
+        goto err;
+    }
+    for (size_t i = 0; i < sizeof(driver_tap_offloads) / sizeof(driver_tap_offloads[0]); i++)
+        if (ioctl(tap.fd, TUNSETOFFLOAD, driver_tap_offloads[i].tun_flags) == 0) {
+            tap.offload = driver_tap_offloads[i].offload;
+            return 0;
+        }
+    fprintf(stderr, "Error in ioctl TUNSETOFFLOAD: %s\n", strerror(errno));
+err:
+    driver_close();
+    return -1;
+}
+
+/**
+ * @brief 判断一个数据包是否应交给协议栈，与pcap后端的过滤规则一致
+ *
+ * @param data 以太网帧
+ * @param len 帧长度
+ * @return int 是为1，否为0
+ */
+static int driver_accept(const uint8_t *data, size_t len) {
+    static const uint8_t broadcast[NET_MAC_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (len < 2 * NET_MAC_LEN)
+        return 0;
+    if (memcmp(data, net_if_mac, NET_MAC_LEN) && memcmp(data, broadcast, NET_MAC_LEN))
+        return 0;
+    return memcmp(data + NET_MAC_LEN, net_if_mac, NET_MAC_LEN) != 0;
+}
+
+/**
+ * @brief 批量接收使用的驱动侧缓冲区及其借用的帧内存，每个数据包处理完后才读下一个，一帧即可
+ *
+ */
+static buf_t driver_rx_buf;
+static uint8_t driver_rx_frame[DRIVER_TAP_FRAME_MAX];
+
+/**
+ * @brief 试图从网卡一次接收并处理多个数据包
+ *
+ * @param handler 每个数据包的处理程序，数据包借用驱动侧的帧内存，只在处理程序返回前有效
+ * @param max 最多接收的数据包个数
+ * @return int 收到的数据包个数，未收到为0，错误为-1
+ */
+int driver_recv_batch(driver_handler_t handler, int max) {
+    int count = 0;
+    while (count < max) {
+        ssize_t len = read(tap.fd, driver_rx_frame, DRIVER_TAP_FRAME_MAX);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            fprintf(stderr, "Error in driver_recv_batch: %s\n", strerror(errno));
+            return count ? count : -1;
+        }
+        struct virtio_net_hdr *vnet = (struct virtio_net_hdr *)driver_rx_frame;
+        uint8_t *data = driver_rx_frame + sizeof(*vnet);
+        len -= sizeof(*vnet);
+        if (len <= 0 || !driver_accept(data, len))
+            continue;
+        buf_borrow(&driver_rx_buf, data, len);
+        // 内核本地产生的包只带部分校验和（NEEDS_CSUM），与已校验过（DATA_VALID）一样可信
+        if (vnet->flags & (VIRTIO_NET_HDR_F_DATA_VALID | VIRTIO_NET_HDR_F_NEEDS_CSUM))
+            driver_rx_buf.flags |= BUF_CSUM_VALID;
+        handler(&driver_rx_buf);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief driver_recv的拷贝目标
+ *
+ */
+static buf_t *driver_recv_dst;
+
+/**
+ * @brief driver_recv使用的处理程序，把借用的数据包拷贝到调用者的buf中
+ *
+ * @param rx 收到的数据包
+ */
+static void driver_recv_copy(buf_t *rx) {
+    buf_init(driver_recv_dst, rx->len);
+    memcpy(driver_recv_dst->data, rx->data, rx->len);
+    driver_recv_dst->flags = rx->flags;
+}
+
+/**
+ * @brief 试图从网卡接收数据包
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf) {
+    driver_recv_dst = buf;
+    if (driver_recv_batch(driver_recv_copy, 1) <= 0)
+        return 0;
+    return buf->len;
+}
+
+/**
+ * @brief 根据BUF_CSUM_PARTIAL和BUF_GSO标志填写以太网帧的virtio-net头
+ *
+ * @param buf 要发送的以太网帧
+ * @param vnet 出口参数，virtio-net头
+ * @return int 成功为0，帧不是可卸载的IPv4 TCP/UDP报文为-1
+ */
+static int driver_vnet_hdr(buf_t *buf, struct virtio_net_hdr *vnet) {
+    memset(vnet, 0, sizeof(*vnet));
+    if (!(buf->flags & (BUF_CSUM_PARTIAL | BUF_GSO)))
+        return 0;
+    if (buf->len < 14 + sizeof(ip_hdr_t) || buf->data[12] != 0x08 || buf->data[13] != 0x00)
+        return -1;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)(buf->data + 14);
+    uint16_t l4_start = 14 + ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    uint16_t l4_hdr_len;
+    if (ip_hdr->protocol == NET_PROTOCOL_TCP && buf->len >= l4_start + 20u) {
+        vnet->csum_offset = 16;
+        vnet->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+        l4_hdr_len = (buf->data[l4_start + 12] >> 4) * 4;
+    } else if (ip_hdr->protocol == NET_PROTOCOL_UDP && buf->len >= l4_start + 8u) {
+        vnet->csum_offset = 6;
+        vnet->gso_type = VIRTIO_NET_HDR_GSO_UDP;
+        l4_hdr_len = 0;  // UFO按IP分片切分，分片负载从UDP头部开始计算
+    } else
+        return -1;
+    vnet->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vnet->csum_start = l4_start;
+    if (buf->flags & BUF_GSO) {
+        vnet->hdr_len = l4_start + (l4_hdr_len ? l4_hdr_len : 8);
+        vnet->gso_size = net_if_mtu - (l4_start - 14) - l4_hdr_len;
+    } else
+        vnet->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+    return 0;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf) {
+    struct virtio_net_hdr vnet;
+    if (driver_vnet_hdr(buf, &vnet) < 0) {
+        fprintf(stderr, "Error in driver_send: offload requested on a non TCP/UDP frame.\n");
+        return -1;
+    }
+    struct iovec iov[3] = {
+        {.iov_base = &vnet, .iov_len = sizeof(vnet)},
+        {.iov_base = buf->data, .iov_len = buf->len},
+        {.iov_base = buf->slice, .iov_len = buf->slice_len},  // 分散聚合的第二段数据直接交给内核
+    };
+    if (writev(tap.fd, iov, buf->slice_len ? 3 : 2) < 0) {
+        fprintf(stderr, "Error in driver_send: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 发出发送队列中的数据包。TAP设备没有一次写入多帧的接口，
+ * driver_send已逐帧写入，这里无事可做
+ *
+ * @return int 成功为0
+ */
+int driver_flush() {
+    return 0;
+}
+
+/**
+ * @brief 查询驱动后端支持的卸载能力
+ *
+ * @return int DRIVER_OFFLOAD_*的组合
+ */
+int driver_offload() {
+    return tap.offload;
+}
+
+/**
+ * @brief 获取可用于select/epoll等待数据包到达的文件描述符
+ *
+ * @return int 文件描述符，未打开为-1
+ */
+int driver_fd() {
+    return tap.fd;
+}
+
+/**
+ * @brief 关闭网卡
+ *
+ */
+void driver_close() {
+    if (tap.fd >= 0)
+        close(tap.fd);
+    tap.fd = -1;
+    tap.offload = 0;
+}
+#endif
@@ -4,6 +4,13 @@
 #include "driver.h"
 #include "ip.h"
 #include "utils.h"
+
+/**
+ * @brief 以太网接收统计
+ *
+ */
+static ethernet_stats_t ethernet_stats = {.rx_batch = ETHERNET_RX_BATCH};
+
 /**
  * @brief 处理一个收到的数据包
  *
@@ -35,8 +42,8 @@ void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol) {
     // TO-DO
 
     // 检查数据长度,如数据长度不足46（最小数据长）需要补
-    if (buf->len < ETHERNET_MIN_TRANSPORT_UNIT) {
-        buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - buf->len);
+    if (buf->len + buf->slice_len < ETHERNET_MIN_TRANSPORT_UNIT) {
+        buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - buf->len - buf->slice_len);
     }
     // 添加以太网包头
     buf_add_header(buf, sizeof(ether_hdr_t));
@@ -60,8 +67,41 @@ void ethernet_init() {
 /**
  * @brief 一次以太网轮询
  *
+ * @return int 本次收到的帧数
+ */
+int ethernet_poll() {
+    int total = 0, n;
+    ethernet_stats.polls++;
+    while (total < ethernet_stats.rx_batch && (n = driver_recv_batch(ethernet_in, ethernet_stats.rx_batch - total)) > 0)
+        total += n;
+    if (total == 0)
+        return 0;
+    ethernet_stats.rx_batches++;
+    ethernet_stats.rx_frames += total;
+    ethernet_stats.rx_batch_last = total;
+    if (total > ethernet_stats.rx_batch_peak)
+        ethernet_stats.rx_batch_peak = total;
+    return total;
+}
+
+/**
+ * @brief 设置每次以太网轮询最多接收的帧数
+ *
+ * @param batch 批大小，会被限制在[1, ETHERNET_RX_BATCH_MAX]内
+ */
+void ethernet_set_rx_batch(int batch) {
+    if (batch < 1)
+        batch = 1;
+    if (batch > ETHERNET_RX_BATCH_MAX)
+        batch = ETHERNET_RX_BATCH_MAX;
+    ethernet_stats.rx_batch = batch;
+}
+
+/**
+ * @brief 获取以太网接收统计
+ *
+ * @return const ethernet_stats_t* 统计信息
  */
-void ethernet_poll() {
-    if (driver_recv(&rxbuf) > 0)
-        ethernet_in(&rxbuf);
+const ethernet_stats_t *ethernet_get_stats() {
+    return &ethernet_stats;
 }
@@ -16,7 +16,6 @@ static void icmp_resp(buf_t *req_buf, uint8_t *src_ip) {
     icmp_hdr_t * icmp_header = (icmp_hdr_t*)txbuf.data;
     icmp_header->type = ICMP_TYPE_ECHO_REPLY; //type为回显响应
     icmp_header->code = 0; // code为0
-    icmp_header->checksum16 = 0; // 校验和先清空
     // id:如果是ICMP应答报文，则只需拷贝来自ICMP请求报文的标识符字段；
     icmp_hdr_t * icmp_header_req = (icmp_hdr_t*)req_buf->data;
     icmp_header->id16 = icmp_header_req->id16; // id
@@ -26,10 +25,8 @@ static void icmp_resp(buf_t *req_buf, uint8_t *src_ip) {
     // 后面搭载的数据部分拷贝自req buf
     memcpy(txbuf.data + sizeof(icmp_hdr_t), req_buf->data + sizeof(icmp_hdr_t), req_buf->len - sizeof(icmp_hdr_t));
 
-    // icmp 校验和是全部的校验和
-    uint16_t checksum = checksum16((uint16_t*)txbuf.data, txbuf.len);  // 计算校验和
-
-    icmp_header->checksum16 = checksum;  // 设置校验和
+    // 响应与请求只差type和code所在的16位字，由请求的校验和增量更新，不再累加整个数据部分
+    icmp_header->checksum16 = checksum16_update(icmp_header_req->checksum16, &icmp_header_req->type, &icmp_header->type, 2);
 
     ip_out(&txbuf, src_ip, NET_PROTOCOL_ICMP);  // 发送icmp响应
 
@@ -57,6 +54,21 @@ void icmp_in(buf_t *buf, uint8_t *src_ip) {
     // 看是不是回显
     if (type == ICMP_TYPE_ECHO_REQUEST && code == 0) {
         icmp_resp(buf, src_ip);  // 回显请求，发送响应
+    } else if (type == ICMP_TYPE_UNREACH && code == ICMP_CODE_FRAG_NEEDED && buf->len >= sizeof(icmp_hdr_t) + sizeof(ip_hdr_t)) {
+        // 需要分片：差错报文携带被丢弃的数据包的头部，序号字段是下一跳MTU（RFC 1191）
+        // 降低的路径MTU会保持IP_PMTU_TIMEOUT_SEC，只相信校验和正确、引用的确实是我们发出的、比报告的MTU大的tcp/udp数据包的差错
+        if (checksum16((uint16_t *)buf->data, buf->len) != 0)
+            return;
+        ip_hdr_t *ip_header = (ip_hdr_t *)(buf->data + sizeof(icmp_hdr_t));
+        uint16_t mtu = swap16(icmp_header->seq16);
+        uint16_t sent_len = swap16(ip_header->total_len16);
+        if (ip_header->version != IP_VERSION_4 || memcmp(ip_header->src_ip, net_if_ip, NET_IP_LEN))
+            return;
+        if (ip_header->protocol != NET_PROTOCOL_TCP && ip_header->protocol != NET_PROTOCOL_UDP)
+            return;
+        if (sent_len <= (mtu ? mtu : IP_PMTU_MIN))
+            return;
+        ip_pmtu_update(ip_header->dst_ip, mtu, sent_len);
     }
 }
 
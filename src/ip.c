@@ -4,6 +4,265 @@
 #include "ethernet.h"
 #include "icmp.h"
 #include "net.h"
+#include "route.h"
+#include "timer.h"
+
+#include <string.h>
+
+#define IP_REASM_HOLE_END UINT32_MAX  // 最后一个分片到达前，末尾空洞的结束位置
+
+typedef struct ip_reasm_hole  // 重组中尚未收到的一段数据，[first, last)
+{
+    uint32_t first;  // 起始偏移
+    uint32_t last;   // 结束偏移，不含
+} ip_reasm_hole_t;
+
+typedef struct ip_reasm  // 一个正在重组的数据包
+{
+    uint8_t used;                                // 是否在使用
+    uint8_t src_ip[NET_IP_LEN];                  // 键：源ip
+    uint8_t dst_ip[NET_IP_LEN];                  // 键：目的ip
+    uint16_t id16;                               // 键：标识符，网络字节序
+    uint8_t protocol;                            // 键：上层协议
+    ip_hdr_t header;                             // 偏移为0的分片的头部，重组完成后据此生成头部
+    buf_t buf;                                   // 已收到的负载，长度为已收到的最大结束偏移，空洞处为0
+    size_t mem;                                  // buf持有的块的容量，计入重组内存上限
+    size_t total_len;                            // 负载总长度，最后一个分片到达前为0
+    int hole_num;                                // 空洞个数，为0且total_len已知时重组完成
+    ip_reasm_hole_t holes[IP_REASM_MAX_HOLES];  // 空洞列表，按RFC 815的方式随分片到达拆分
+    time_t created;                              // 收到第一个分片的时间，淘汰时先淘汰最早的
+    timer_event_t timer;                         // 重组超时定时器
+} ip_reasm_t;
+
+/**
+ * @brief 正在重组的数据包。定时器嵌入在其中，槽位不能移动，所以不用map
+ *
+ */
+static ip_reasm_t ip_reasm_table[IP_REASM_MAX_DATAGRAMS];
+
+/**
+ * @brief 分片重组的统计
+ *
+ */
+static ip_reasm_stats_t ip_reasm_stats;
+
+/**
+ * @brief 把完整的数据包交给上层协议，没有对应的处理程序时回复协议不可达
+ *
+ * @param buf 要交付的数据包，含ip头部
+ * @param ip_header ip头部
+ */
+static void ip_deliver(buf_t *buf, ip_hdr_t *ip_header) {
+    buf_remove_header(buf, sizeof(ip_hdr_t));  // 去除ip头部
+    if (net_in(buf, ip_header->protocol, ip_header->src_ip) == -1) {
+        buf_add_header(buf, sizeof(ip_hdr_t));
+        icmp_unreachable(buf, ip_header->src_ip, ICMP_CODE_PROTOCOL_UNREACH);  // 发送不可达
+    }
+}
+
+/**
+ * @brief 释放一个正在重组的数据包
+ *
+ * @param reasm 要释放的数据包
+ */
+static void ip_reasm_free(ip_reasm_t *reasm) {
+    timer_cancel(&reasm->timer);
+    ip_reasm_stats.mem -= reasm->mem;
+    buf_unref(&reasm->buf);
+    reasm->used = 0;
+}
+
+/**
+ * @brief 重组超时，放弃已收到的分片
+ *
+ * @param arg 超时的数据包
+ */
+static void ip_reasm_timeout(void *arg) {
+    ip_reasm_stats.timeouts++;
+    ip_reasm_free(arg);
+}
+
+/**
+ * @brief 淘汰最早开始重组的数据包
+ *
+ * @param except 不淘汰的数据包，可为NULL
+ * @return int 淘汰了一个为0，没有可淘汰的为-1
+ */
+static int ip_reasm_evict(ip_reasm_t *except) {
+    ip_reasm_t *oldest = NULL;
+    for (int i = 0; i < IP_REASM_MAX_DATAGRAMS; i++) {
+        ip_reasm_t *reasm = &ip_reasm_table[i];
+        if (reasm->used && reasm != except && (!oldest || reasm->created < oldest->created))
+            oldest = reasm;
+    }
+    if (!oldest)
+        return -1;
+    ip_reasm_stats.evictions++;
+    ip_reasm_free(oldest);
+    return 0;
+}
+
+/**
+ * @brief 查找分片所属的数据包，没有则新建
+ *
+ * @param ip_header 分片的头部
+ * @return ip_reasm_t* 所属的数据包
+ */
+static ip_reasm_t *ip_reasm_find(ip_hdr_t *ip_header) {
+    ip_reasm_t *free_slot = NULL;
+    for (int i = 0; i < IP_REASM_MAX_DATAGRAMS; i++) {
+        ip_reasm_t *reasm = &ip_reasm_table[i];
+        if (!reasm->used) {
+            if (!free_slot)
+                free_slot = reasm;
+            continue;
+        }
+        if (reasm->id16 == ip_header->id16 && reasm->protocol == ip_header->protocol &&
+            !memcmp(reasm->src_ip, ip_header->src_ip, NET_IP_LEN) && !memcmp(reasm->dst_ip, ip_header->dst_ip, NET_IP_LEN))
+            return reasm;
+    }
+    if (!free_slot) {  // 没有空闲槽位，淘汰最早的数据包
+        ip_reasm_evict(NULL);
+        for (free_slot = ip_reasm_table; free_slot->used; free_slot++)
+            ;
+    }
+    ip_reasm_t *reasm = free_slot;
+    memset(reasm, 0, sizeof(ip_reasm_t));
+    reasm->used = 1;
+    memcpy(reasm->src_ip, ip_header->src_ip, NET_IP_LEN);
+    memcpy(reasm->dst_ip, ip_header->dst_ip, NET_IP_LEN);
+    reasm->id16 = ip_header->id16;
+    reasm->protocol = ip_header->protocol;
+    reasm->hole_num = 1;
+    reasm->holes[0].first = 0;
+    reasm->holes[0].last = IP_REASM_HOLE_END;
+    reasm->created = net_now();
+    timer_setup(&reasm->timer, ip_reasm_timeout, reasm);
+    timer_add(&reasm->timer, IP_REASM_TIMEOUT_SEC * 1000);
+    return reasm;
+}
+
+/**
+ * @brief 处理一个收到的分片，数据包的所有分片都到达后交给上层协议。
+ * 与已收到的数据完全重复的分片被忽略，部分重叠的分片使整个数据包被放弃，两者都计入overlaps
+ *
+ * @param buf 收到的分片，含ip头部，已去除填充
+ * @param ip_header 分片的头部
+ */
+static void ip_reasm_in(buf_t *buf, ip_hdr_t *ip_header) {
+    uint16_t flags_fragment = swap16(ip_header->flags_fragment16);
+    int mf = (flags_fragment & IP_MORE_FRAGMENT) != 0;
+    uint32_t first = (flags_fragment & IP_FRAGMENT_OFFSET_MASK) * IP_HDR_OFFSET_PER_BYTE;
+    if (buf->len < sizeof(ip_hdr_t))
+        return;
+    uint32_t len = buf->len - sizeof(ip_hdr_t);
+    uint32_t last = first + len;
+    if (last > IP_MAX_PAYLOAD || (mf && (len == 0 || len % IP_HDR_OFFSET_PER_BYTE)))  // 超长，或不是最后一个分片却不按8字节对齐
+        return;
+
+    ip_reasm_t *reasm = ip_reasm_find(ip_header);
+    if (!mf && ((reasm->total_len && reasm->total_len != last) || reasm->buf.len > last)) {  // 与已知的总长度矛盾
+        ip_reasm_stats.overlaps++;
+        ip_reasm_free(reasm);
+        return;
+    }
+    if (mf && reasm->total_len && last > reasm->total_len) {
+        ip_reasm_stats.overlaps++;
+        ip_reasm_free(reasm);
+        return;
+    }
+
+    // 分片须完整落在一个空洞内；与所有空洞都不相交则是重复的分片
+    int hole = -1;
+    int intersect = 0;
+    for (int i = 0; i < reasm->hole_num; i++) {
+        if (reasm->holes[i].first <= first && last <= reasm->holes[i].last) {
+            hole = i;
+            break;
+        }
+        if (reasm->holes[i].first < last && first < reasm->holes[i].last)
+            intersect = 1;
+    }
+    if (hole < 0) {
+        ip_reasm_stats.overlaps++;
+        if (intersect)
+            ip_reasm_free(reasm);
+        return;
+    }
+
+    // 为数据留出空间，按实际持有的块容量计入内存，超过上限时淘汰其他数据包
+    if (reasm->buf.len < last) {
+        if (buf_add_padding(&reasm->buf, last - reasm->buf.len) < 0) {
+            ip_reasm_stats.evictions++;
+            ip_reasm_free(reasm);
+            return;
+        }
+        size_t held = buf_capacity(&reasm->buf);
+        ip_reasm_stats.mem += held - reasm->mem;
+        reasm->mem = held;
+        while (ip_reasm_stats.mem > IP_REASM_MAX_MEM && ip_reasm_evict(reasm) == 0)
+            ;
+        if (ip_reasm_stats.mem > IP_REASM_MAX_MEM) {
+            ip_reasm_stats.evictions++;
+            ip_reasm_free(reasm);
+            return;
+        }
+    }
+    memcpy(reasm->buf.data + first, buf->data + sizeof(ip_hdr_t), len);
+    if (first == 0)
+        memcpy(&reasm->header, ip_header, sizeof(ip_hdr_t));
+
+    // 拆分空洞：[hole.first, first)与[last, hole.last)中非空的留下
+    ip_reasm_hole_t filled = reasm->holes[hole];
+    reasm->holes[hole] = reasm->holes[--reasm->hole_num];
+    if (filled.first < first) {
+        if (reasm->hole_num == IP_REASM_MAX_HOLES) {
+            ip_reasm_stats.evictions++;
+            ip_reasm_free(reasm);
+            return;
+        }
+        reasm->holes[reasm->hole_num++] = (ip_reasm_hole_t){filled.first, first};
+    }
+    if (last < filled.last && mf) {
+        if (reasm->hole_num == IP_REASM_MAX_HOLES) {
+            ip_reasm_stats.evictions++;
+            ip_reasm_free(reasm);
+            return;
+        }
+        reasm->holes[reasm->hole_num++] = (ip_reasm_hole_t){last, filled.last};
+    }
+    if (!mf) {  // 最后一个分片确定了总长度，去掉其后的空洞
+        reasm->total_len = last;
+        for (int i = 0; i < reasm->hole_num;) {
+            if (reasm->holes[i].last > last)
+                reasm->holes[i].last = last;
+            if (reasm->holes[i].first >= reasm->holes[i].last)
+                reasm->holes[i] = reasm->holes[--reasm->hole_num];
+            else
+                i++;
+        }
+    }
+    if (reasm->hole_num || !reasm->total_len)
+        return;
+
+    // 重组完成，还原头部后交付
+    buf_add_header(&reasm->buf, sizeof(ip_hdr_t));
+    ip_hdr_t *header = (ip_hdr_t *)reasm->buf.data;
+    memcpy(header, &reasm->header, sizeof(ip_hdr_t));
+    header->total_len16 = swap16(reasm->buf.len);
+    header->flags_fragment16 = 0;
+    header->hdr_checksum16 = 0;
+    header->hdr_checksum16 = checksum16((uint16_t *)header, sizeof(ip_hdr_t));
+    buf_t datagram = reasm->buf;  // 先释放槽位再交付，上层处理时槽位可被复用
+    reasm->buf.block = NULL;
+    ip_reasm_stats.mem -= reasm->mem;
+    ip_reasm_stats.reassembled++;
+    timer_cancel(&reasm->timer);
+    reasm->used = 0;
+    ip_deliver(&datagram, header);
+    buf_unref(&datagram);
+}
+
 
 /**
  * @brief 处理一个收到的数据包
@@ -26,18 +285,11 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
     if (ip_header->version == IP_VERSION_4 && swap16(ip_header->total_len16) <= buf->len) {
         // 版本号和总长度都正确
         
-        // 储存校验和
-        uint16_t checksum_tmp = ip_header->hdr_checksum16; 
-        // 计算校验和
-        ip_header->hdr_checksum16 = 0;  // 先清空校验和
-        uint16_t checksum = checksum16((uint16_t*)ip_header, sizeof(ip_hdr_t));  // 计算校验和   //按照我们的代码，首部长度是写死的。但是按理说应该用首部中的首部长度字段
-        //对比
-        if (checksum != checksum_tmp){
+        // 校验和检查。BUF_CSUM_VALID只担保传输层校验和，ip头部总要自己校验
+        // 连同校验和字段一起计算，正确时结果为0；数据包可能借用驱动的内存，不改写头部
+        if (checksum16((uint16_t *)ip_header, sizeof(ip_hdr_t)) != 0) {
             return; // 校验和不相等丢弃
-
-        } 
-
-        ip_header->hdr_checksum16 = checksum_tmp;
+        }
         
         // 处理数据包
         // 对比ip地址,这是数组，应用memcmp
@@ -53,22 +305,60 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
             buf_remove_padding(buf, buf->len - swap16(ip_header->total_len16));
         }
 
-        // 去掉报头
-        buf_remove_header(buf, sizeof(ip_hdr_t));  // 去除ip头部
-
-        int netinret = net_in(buf, ip_header->protocol, ip_header->src_ip);  // 调用net_in函数处理上层协议  // 为什么第三个参数是src_mac? 
-        if(netinret == -1) {
-            // 如果没有处理程序，丢弃
-            
-            buf_add_header(buf, sizeof(ip_hdr_t));
-            icmp_unreachable(buf, ip_header->src_ip, ICMP_CODE_PROTOCOL_UNREACH);  // 发送不可达
+        // 分片交给重组，所有分片到达后再交给上层
+        if (swap16(ip_header->flags_fragment16) & (IP_MORE_FRAGMENT | IP_FRAGMENT_OFFSET_MASK)) {
+            ip_reasm_in(buf, ip_header);
+            return;
         }
-            
+
+        ip_deliver(buf, ip_header);  // 去掉报头，调用net_in函数处理上层协议
+
     }
 
 }
 /**
- * @brief 处理一个要发送的ip分片
+ * @brief 路径MTU表 <目的ip,路径MTU>的容器，只记录比网卡MTU小的路径，过期后恢复网卡MTU
+ *
+ */
+static map_t ip_pmtu_table;
+
+/**
+ * @brief 获取发往目的地址的路径MTU
+ *
+ * @param dst_ip 目的ip地址
+ * @return uint16_t 路径MTU，未降低过时为网卡MTU
+ */
+uint16_t ip_pmtu(const uint8_t *dst_ip) {
+    if (!map_size(&ip_pmtu_table))
+        return net_if_mtu;
+    uint16_t *mtu = map_get(&ip_pmtu_table, dst_ip);
+    return mtu && *mtu < net_if_mtu ? *mtu : net_if_mtu;
+}
+
+/**
+ * @brief 收到“需要分片”差错后降低到目的地址的路径MTU。
+ * 没有给出下一跳MTU的旧式路由器按RFC 1191的平台值估计
+ *
+ * @param dst_ip 目的ip地址
+ * @param mtu 差错报文给出的下一跳MTU，为0则未给出
+ * @param sent_len 被丢弃的数据包的总长度
+ */
+void ip_pmtu_update(const uint8_t *dst_ip, uint16_t mtu, uint16_t sent_len) {
+    static const uint16_t plateaus[] = {32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296, 68};
+    if (mtu == 0) {
+        for (size_t i = 0; i < sizeof(plateaus) / sizeof(plateaus[0]) && !mtu; i++)
+            if (plateaus[i] < sent_len)
+                mtu = plateaus[i];
+    }
+    if (mtu < IP_PMTU_MIN)
+        mtu = IP_PMTU_MIN;
+    if (mtu >= ip_pmtu(dst_ip))  // 只降不升，升高靠过期后重新探测
+        return;
+    map_set(&ip_pmtu_table, dst_ip, &mtu);
+}
+
+/**
+ * @brief 处理一个要发送的ip分片，下一跳的mac先查调用者持有的缓存
  *
  * @param buf 要发送的分片
  * @param ip 目标ip地址
@@ -76,8 +366,9 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
  * @param id 数据包id
  * @param offset 分片offset，必须被8整除
  * @param mf 分片mf标志，是否有下一个分片
+ * @param cache 下一跳mac缓存，为NULL则查arp表
  */
-void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
+static void ip_fragment_out_cached(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf, arp_cache_t *cache) {
     // TO-DO
 
     // 这个函数需要设置完整的ip头部内容。如果内容有误就会出错
@@ -85,13 +376,15 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
 
     // 申请一个ip头部
     buf_add_header(buf, sizeof(ip_hdr_t));  // 添加ip头部
-    // 填写头部
     ip_hdr_t * ip_header = (ip_hdr_t *)buf->data;
+    // 填写头部
     ip_header->version = IP_VERSION_4;
     ip_header->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;  // 头部长度
     ip_header->tos = 0;  // 服务类型
-    ip_header->total_len16 = swap16(buf->len);  // 总长度 大小端转换是要的
+    ip_header->total_len16 = swap16(buf->len + buf->slice_len);  // 总长度 大小端转换是要的
     ip_header->flags_fragment16 = swap16((mf ? IP_MORE_FRAGMENT : 0) | (offset / IP_HDR_OFFSET_PER_BYTE));  // 标志与分段
+    if (IP_PMTU_DISCOVERY && !offset && !mf && ip_pmtu(ip) > IP_PMTU_MIN)  // 不分片的数据包置DF位，由路径上的路由器报告更小的MTU
+        ip_header->flags_fragment16 |= swap16(IP_DONT_FRAGMENT);
     ip_header->id16 = swap16(id);  // 标识符
 
     ip_header->ttl = IP_DEFALUT_TTL;  // 存活时间
@@ -101,10 +394,24 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
     ip_header->hdr_checksum16 = 0;
     uint16_t checksum = checksum16((uint16_t*)ip_header, sizeof(ip_hdr_t));  // 计算校验和
     ip_header->hdr_checksum16 = checksum;  // 设置校验和
-    arp_out(buf, ip);  // 调用arp_out函数发送
+    arp_out_cached(buf, (uint8_t *)route_lookup(ip), cache);  // 按路由发往下一跳，直连时即目标ip
 }  
 
 
+/**
+ * @brief 处理一个要发送的ip分片
+ *
+ * @param buf 要发送的分片
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ * @param id 数据包id
+ * @param offset 分片offset，必须被8整除
+ * @param mf 分片mf标志，是否有下一个分片
+ */
+void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
+    ip_fragment_out_cached(buf, ip, protocol, id, offset, mf, NULL);
+}
+
 /**
  * @brief 处理一个要发送的ip数据包
  *
@@ -113,52 +420,49 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
  * @param protocol 上层协议
  */
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
+    ip_out_cached(buf, ip, protocol, NULL);
+}
+
+/**
+ * @brief 处理一个要发送的ip数据包，下一跳的mac先查调用者持有的缓存，如tcp连接中的
+ *
+ * @param buf 要处理的包
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ * @param cache 下一跳mac缓存，为NULL则查arp表
+ */
+void ip_out_cached(buf_t *buf, uint8_t *ip, net_protocol_t protocol, arp_cache_t *cache) {
     // TO-DO
     // 这个buf是上层下来的，没有ip头的。ip头在 fragmentout函数才装
     static uint16_t ip_id = 0;
     uint16_t current_id = ip_id++;
-    // 检查上层下来的包长度
-    if(buf->len > ETHERNET_MAX_TRANSPORT_UNIT - sizeof(ip_hdr_t)) {
-        // 包长超过了Ip协议最大负载长（1480） 需要分片
-
-        // 为了分片，可以直接操纵 buf的data部分
-        uint8_t * data_ptr = buf->data;  // 用data_ptr 直接遍历数据部分
-        size_t remain_data = buf->len;  // 剩余数据长度
-        int offset = 0;  // 偏移用于标记传给ip_header的偏移量
-        size_t current_data_size = 0;
-        while (remain_data > 1480) {
-            current_data_size = 1480;
-            // 创建新缓冲区
-            buf_t ip_buf = {0};
-            buf_init(&ip_buf, current_data_size);  // 创建新的buf
-            memcpy(ip_buf.data, data_ptr, current_data_size);  // 拷贝数据
-            
-            ip_fragment_out(&ip_buf, ip, protocol, current_id, offset, 1);  // 发送分片
-
-            offset += current_data_size;
-            remain_data -= current_data_size;
-            data_ptr += current_data_size;  // 移动指针
-        }
-        
-         // 处理最后一个分片
-        current_data_size = remain_data; 
-        buf_t ip_buf = {0};
-        buf_init(&ip_buf, current_data_size);  // 创建新的buf
-        memcpy(ip_buf.data, data_ptr, remain_data);  // 拷贝数据
-        if (remain_data % 8 != 0) {
-            // 计算需要填充的字节数
-            int padding = 8 - (remain_data % 8);
-            // 填充数据
-            buf_add_padding(&ip_buf, padding);
+    // 检查上层下来的包长度，交给驱动后端分段的大包（BUF_GSO）不在这里分片
+    uint16_t mtu = ip_pmtu(ip);
+    if(!(buf->flags & BUF_GSO) && buf->len > mtu - sizeof(ip_hdr_t)) {
+        // 包长超过了路径MTU能承载的负载长度，需要分片
+        // 每个分片只新建头部，负载是原数据包的切片，由驱动后端分散聚合发出，不拷贝数据
+        size_t max_data_size = (mtu - sizeof(ip_hdr_t)) & ~(size_t)(IP_HDR_OFFSET_PER_BYTE - 1);  // 除最后一片外，分片负载须是8的倍数
+        // 先持有一个引用再切片：buf常是全局的txbuf，发送分片途中arp请求/探测会用buf_init改写它
+        buf_t src;
+        buf_ref(&src, buf, 0);
+        size_t total_len = src.len;
+        buf_t ip_buf = {0};  // 各分片复用同一个buf，未被缓存时不重新分配
+        for (size_t offset = 0; offset < total_len; offset += max_data_size) {
+            size_t current_data_size = total_len - offset < max_data_size ? total_len - offset : max_data_size;
+            int mf = offset + current_data_size < total_len;
+            if (buf_slice(&ip_buf, &src, offset, current_data_size) < 0)
+                break;
+            if (!mf && current_data_size % 8 != 0) {
+                // 最后一个分片补齐到8的倍数
+                buf_add_padding(&ip_buf, 8 - (current_data_size % 8));
+            }
+            ip_fragment_out_cached(&ip_buf, ip, protocol, current_id, offset, mf, cache);  // 发送分片
         }
-        
-        // 发送最后一个分片
-        ip_fragment_out(&ip_buf, ip, protocol, current_id, offset, 0);
-
-        
+        buf_unref(&ip_buf);
+        buf_unref(&src);
     } else {
         // 直接调用ip_fragment_out发
-        ip_fragment_out(buf, ip, protocol,current_id  ,0, 0);  // id16是ip头部的id
+        ip_fragment_out_cached(buf, ip, protocol, current_id, 0, 0, cache);  // id16是ip头部的id
     }
 }
 
@@ -167,5 +471,20 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
  *
  */
 void ip_init() {
+    for (int i = 0; i < IP_REASM_MAX_DATAGRAMS; i++)  // 时间轮已重新初始化，不需要取消定时器
+        if (ip_reasm_table[i].used)
+            buf_unref(&ip_reasm_table[i].buf);
+    memset(ip_reasm_table, 0, sizeof(ip_reasm_table));
+    memset(&ip_reasm_stats, 0, sizeof(ip_reasm_stats));
+    map_init(&ip_pmtu_table, NET_IP_LEN, sizeof(uint16_t), 0, IP_PMTU_TIMEOUT_SEC, NULL, NULL, NULL, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
 }
+
+/**
+ * @brief 获取分片重组的统计
+ *
+ * @return const ip_reasm_stats_t* 统计信息
+ */
+const ip_reasm_stats_t *ip_reasm_get_stats() {
+    return &ip_reasm_stats;
+}
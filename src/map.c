@@ -1,7 +1,34 @@
 #include "map.h"
 
+#include "net.h"
+
 #include <string.h>
 
+#define MAP_ALIGN(len) (((len) + sizeof(time_t) - 1) & ~(sizeof(time_t) - 1))  // 槽位内各字段按time_t对齐
+
+/**
+ * 槽位布局：| 更新时间 time_t，net_now()的毫秒数 | 键（对齐） | 值 | 占用标志 uint8_t | 填充 |
+ * 更新时间放在最前面并整体对齐，使foreach交给回调的时间指针以及值指针都是对齐的。
+ * 占用与否单独记录，不依赖时间是否为0。
+ */
+
+/**
+ * @brief 默认的键哈希函数，FNV-1a
+ *
+ * @param key 键指针
+ * @param len 键的长度
+ * @return uint32_t 哈希值
+ */
+static uint32_t map_hash_fnv1a(const void *key, size_t len) {
+    const uint8_t *p = key;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 /**
  * @brief 初始化map
  *
@@ -10,23 +37,44 @@
  * @param value_len 值的长度
  * @param max_size 最大容量，为0则根据MAP_MAX_LEN自动设置
  * @param timeout 超时秒数，为0则永不超时
+ * @param key_compare 形如memcmp的键比较函数，为NULL则使用memcmp
+ * @param key_hash 键的哈希函数，须与key_compare一致，为NULL则对键的全部字节做FNV-1a
  * @param value_constuctor 形如memcpy的构造函数，用于拷贝值到容器中，为NULL则使用memcpy
+ * @param value_destructor 值的析构函数，用于释放值持有的资源，为NULL则不调用
+ * @param value_persistent 判断值是否永不超时的函数，如静态arp表项，为NULL则都按timeout超时
  */
-void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_compare_t key_compare, map_constuctor_t value_constuctor) {
-    if (max_size == 0 || max_size * (key_len + value_len + sizeof(time_t)) > MAP_MAX_LEN)
-        max_size = MAP_MAX_LEN / (key_len + value_len + sizeof(time_t));
+void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_compare_t key_compare, map_hash_t key_hash, map_constuctor_t value_constuctor, map_destructor_t value_destructor, map_persistent_t value_persistent) {
+    size_t entry_len = sizeof(time_t) + MAP_ALIGN(key_len) + MAP_ALIGN(value_len + 1);
+    size_t slots = 1;
+    while (slots * 2 * entry_len <= MAP_MAX_LEN)  // 数据区能容纳的最多槽位
+        slots *= 2;
+    if (max_size)
+        while (slots > 2 && (slots / 2) * MAP_MAX_LOAD >= max_size * 100)  // 只需要max_size个键值对时缩小哈希表，遍历更快
+            slots /= 2;
+    size_t max_load = slots * MAP_MAX_LOAD / 100;
+    if (max_load >= slots)  // 至少保留一个空槽位，保证探测能终止
+        max_load = slots - 1;
+    if (max_size == 0 || max_size > max_load)
+        max_size = max_load;
     if (value_constuctor == NULL)
         value_constuctor = (map_constuctor_t)memcpy;
     if (key_compare == NULL)
         key_compare = (map_compare_t)memcmp;
+    if (key_hash == NULL)
+        key_hash = map_hash_fnv1a;
 
     memset(map, 0, sizeof(map_t));
     map->key_len = key_len;
     map->value_len = value_len;
     map->max_size = max_size;
+    map->slots = slots;
+    map->entry_len = entry_len;
     map->timeout = timeout;
     map->key_compare = key_compare;
+    map->key_hash = key_hash;
     map->value_constuctor = value_constuctor;
+    map->value_destructor = value_destructor;
+    map->value_persistent = value_persistent;
 }
 
 /**
@@ -40,28 +88,92 @@ size_t map_size(map_t *map) {
 }
 
 /**
- * @brief 内部函数，获取第n个物理位置的键值对
+ * @brief 内部函数，获取第n个槽位
  *
  * @param map 要获取的map
- * @param pos 位置
- * @return void* 键值对指针
+ * @param pos 槽位下标
+ * @return uint8_t* 槽位指针，指向其更新时间
  */
-void *map_entry_get(map_t *map, size_t pos) {
-    if (pos >= map->max_size)
-        return NULL;
-    return map->data + pos * (map->key_len + map->value_len + sizeof(time_t));
+static inline uint8_t *map_slot(map_t *map, size_t pos) {
+    return map->data + pos * map->entry_len;
+}
+
+static inline void *map_slot_key(map_t *map, uint8_t *slot) {
+    return slot + sizeof(time_t);
+}
+
+static inline void *map_slot_value(map_t *map, uint8_t *slot) {
+    return slot + sizeof(time_t) + MAP_ALIGN(map->key_len);
+}
+
+static inline uint8_t *map_slot_used(map_t *map, uint8_t *slot) {
+    return slot + sizeof(time_t) + MAP_ALIGN(map->key_len) + map->value_len;
 }
 
 /**
- * @brief 内部函数，判断键值对是否有效
+ * @brief 内部函数，计算键应在的槽位
+ *
+ * @param map 要计算的map
+ * @param key 键指针
+ * @return size_t 槽位下标
+ */
+static inline size_t map_home(map_t *map, const void *key) {
+    return map->key_hash(key, map->key_len) & (map->slots - 1);
+}
+
+/**
+ * @brief 内部函数，判断占用的槽位是否已超时
  *
  * @param map 要判断的map
- * @param entry 键值对指针
- * @return int 1为合法，0为不合法
+ * @param slot 槽位指针
+ * @return int 超时为1，否则为0
+ */
+static inline int map_slot_expired(map_t *map, uint8_t *slot) {
+    return map->timeout && *(time_t *)slot + map->timeout * 1000 < net_now() &&
+           !(map->value_persistent && map->value_persistent(map_slot_value(map, slot)));
+}
+
+/**
+ * @brief 内部函数，查找键所在的槽位，不检查是否超时
+ *
+ * @param map 要查找的map
+ * @param key 键指针
+ * @return size_t 槽位下标，找不到为map->slots
  */
-int map_entry_valid(map_t *map, const void *entry) {
-    time_t entry_time = *(time_t *)((uint8_t *)entry + map->key_len + map->value_len);
-    return entry_time && (!map->timeout || entry_time + map->timeout >= time(NULL));
+static size_t map_find(map_t *map, const void *key) {
+    size_t mask = map->slots - 1;
+    for (size_t i = map_home(map, key);; i = (i + 1) & mask) {
+        uint8_t *slot = map_slot(map, i);
+        if (!*map_slot_used(map, slot))
+            return map->slots;
+        if (!map->key_compare(key, map_slot_key(map, slot), map->key_len))
+            return i;
+    }
+}
+
+/**
+ * @brief 内部函数，删除一个槽位上的键值对。之后同一探测序列上的键值对前移填补空位，
+ * 因此不需要墓碑，但其他键值对的值指针可能失效
+ *
+ * @param map 要操作的map
+ * @param pos 槽位下标
+ */
+static void map_erase(map_t *map, size_t pos) {
+    size_t mask = map->slots - 1;
+    if (map->value_destructor)
+        map->value_destructor(map_slot_value(map, map_slot(map, pos)));
+    for (size_t j = (pos + 1) & mask;; j = (j + 1) & mask) {
+        uint8_t *slot = map_slot(map, j);
+        if (!*map_slot_used(map, slot))
+            break;
+        size_t home = map_home(map, map_slot_key(map, slot));
+        if (pos <= j ? (pos < home && home <= j) : (pos < home || home <= j))  // 应在的槽位处于(pos, j]，不能前移
+            continue;
+        memcpy(map_slot(map, pos), slot, map->entry_len);
+        pos = j;
+    }
+    *map_slot_used(map, map_slot(map, pos)) = 0;
+    map->size--;
 }
 
 /**
@@ -69,17 +181,62 @@ int map_entry_valid(map_t *map, const void *entry) {
  *
  * @param map 要获取的map
  * @param key 键指针
- * @return void* 值指针，找不到为NULL
+ * @return void* 值指针，找不到为NULL。在下一次删除或插入前有效
  */
 void *map_get(map_t *map, const void *key) {
+    return map_get_time(map, key, NULL);
+}
+
+/**
+ * @brief 获取map中指定键的值及其更新时间
+ *
+ * @param map 要获取的map
+ * @param key 键指针
+ * @param updated 出口参数，值最后一次map_set的时间，net_now()的毫秒数，为NULL则不获取
+ * @return void* 值指针，找不到为NULL。在下一次删除或插入前有效
+ */
+void *map_get_time(map_t *map, const void *key, time_t *updated) {
     if (key == NULL)
         return NULL;
-    for (size_t i = 0; i < map->max_size; i++) {
-        uint8_t *entry = map_entry_get(map, i);
-        if (map_entry_valid(map, entry) && !map->key_compare(key, entry, map->key_len))
-            return entry + map->key_len;
+    size_t pos = map_find(map, key);
+    if (pos == map->slots)
+        return NULL;
+    uint8_t *slot = map_slot(map, pos);
+    if (map_slot_expired(map, slot))  // 不在这里清理：删除会前移其他键值对，使之前取得的值指针失效。留给遍历或插入时清理
+        return NULL;
+    if (updated)
+        *updated = *(time_t *)slot;
+    return map_slot_value(map, slot);
+}
+
+/**
+ * @brief 内部函数，遍历map并清理超时的键值对
+ *
+ * @param map 要遍历的map
+ * @param handler 对每个未超时的键值对应用的回调函数，为NULL则只清理
+ */
+static void map_scan(map_t *map, map_entry_handler_t handler) {
+    if (map->size == 0)
+        return;
+    size_t mask = map->slots - 1;
+    size_t start = 0;
+    while (*map_slot_used(map, map_slot(map, start)))  // 从空槽位开始，删除时前移的键值对都还未被访问
+        start++;
+    for (size_t n = 1; n <= map->slots;) {
+        size_t pos = (start + n) & mask;
+        uint8_t *slot = map_slot(map, pos);
+        if (!*map_slot_used(map, slot)) {
+            n++;
+            continue;
+        }
+        size_t size = map->size;
+        if (map_slot_expired(map, slot))
+            map_erase(map, pos);
+        else if (handler)
+            handler(map_slot_key(map, slot), map_slot_value(map, slot), (time_t *)slot);
+        if (map->size == size)  // 当前键值对被删除时，后面的键值对可能前移到这里，需再处理一次
+            n++;
     }
-    return NULL;
 }
 
 /**
@@ -91,26 +248,43 @@ void *map_get(map_t *map, const void *key) {
  * @return int 成功为0，失败为-1
  */
 int map_set(map_t *map, const void *key, const void *value) {
-    uint8_t *old_value = map_get(map, key);
-    if (old_value) {
+    return map_set_time(map, key, value, net_now());
+}
+
+/**
+ * @brief 插入或更新map中指定键的值，并指定其更新时间，如从文件恢复的表项保留原来的时间
+ *
+ * @param map 要操作的map
+ * @param key 键指针
+ * @param value 值指针
+ * @param updated 更新时间，net_now()的毫秒数
+ * @return int 成功为0，失败为-1
+ */
+int map_set_time(map_t *map, const void *key, const void *value, time_t updated) {
+    size_t pos = map_find(map, key);
+    if (pos != map->slots) {  // 已有的键，即使已超时也原地更新
+        uint8_t *slot = map_slot(map, pos);
+        void *old_value = map_slot_value(map, slot);
+        if (map->value_destructor)
+            map->value_destructor(old_value);
         map->value_constuctor(old_value, value, map->value_len);
-        *(time_t *)(old_value + map->value_len) = time(NULL);
+        *(time_t *)slot = updated;
         return 0;
     }
+    if (map->size == map->max_size)
+        map_scan(map, NULL);
     if (map->size == map->max_size)
         return -1;
-    for (size_t i = 0; i < map->max_size; i++) {
-        uint8_t *entry = map_entry_get(map, i);
-        if (!map_entry_valid(map, entry)) {
-            memcpy(entry, key, map->key_len);
-            map->value_constuctor(entry + map->key_len, value, map->value_len);
-            *(time_t *)(entry + map->key_len + map->value_len) = time(NULL);
-            map->size++;
-            return 0;
-        }
-    }
-
-    return -1;
+    size_t mask = map->slots - 1;
+    for (pos = map_home(map, key); *map_slot_used(map, map_slot(map, pos)); pos = (pos + 1) & mask)
+        ;
+    uint8_t *slot = map_slot(map, pos);
+    memcpy(map_slot_key(map, slot), key, map->key_len);
+    map->value_constuctor(map_slot_value(map, slot), value, map->value_len);
+    *(time_t *)slot = updated;
+    *map_slot_used(map, slot) = 1;
+    map->size++;
+    return 0;
 }
 
 /**
@@ -120,23 +294,20 @@ int map_set(map_t *map, const void *key, const void *value) {
  * @param key 键指针
  */
 void map_delete(map_t *map, const void *key) {
-    uint8_t *value = map_get(map, key);
-    if (value) {
-        *(time_t *)(value + map->value_len) = 0;
-        map->size--;
-    }
+    if (key == NULL)
+        return;
+    size_t pos = map_find(map, key);
+    if (pos != map->slots)
+        map_erase(map, pos);
 }
 
 /**
- * @brief 遍历map
+ * @brief 遍历map，顺带清理超时的键值对
  *
  * @param map 要遍历的map
- * @param handler 对每个键值对应用的回调函数，参数为（键指针，值指针，更新时间指针）
+ * @param handler 对每个键值对应用的回调函数，参数为（键指针，值指针，更新时间指针），为NULL则只清理。
+ * 回调中只允许删除当前键值对，不允许插入
  */
 void map_foreach(map_t *map, map_entry_handler_t handler) {
-    for (size_t i = 0; i < map->max_size; i++) {
-        uint8_t *entry = map_entry_get(map, i);
-        if (map_entry_valid(map, entry))
-            handler(entry, entry + map->key_len, (time_t *)(entry + map->key_len + map->value_len));
-    }
+    map_scan(map, handler);
 }
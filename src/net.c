@@ -5,9 +5,19 @@
 #include "ethernet.h"
 #include "icmp.h"
 #include "ip.h"
+#include "route.h"
 #include "tcp.h"
+#include "timer.h"
 #include "udp.h"
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 /**
  * @brief 协议表 <协议号,处理程序>的容器
  *
@@ -26,22 +36,74 @@ uint8_t net_if_mac[NET_MAC_LEN] = NET_IF_MAC;
  */
 uint8_t net_if_ip[NET_IP_LEN] = NET_IF_IP;
 
+/**
+ * @brief 网卡MTU，即一帧能承载的最长IP数据包
+ *
+ */
+uint16_t net_if_mtu = NET_IF_MTU;
+
 /**
  * @brief 网卡接收和发送缓冲区
  *
  */
 buf_t rxbuf, txbuf;  // 一个buf足够单线程使用
 
+/**
+ * @brief 协议栈时钟，每轮询一次刷新一次，各协议在同一轮中看到相同的时间
+ *
+ */
+static struct {
+    net_clock_t source;  // 外部注入的时钟源，为NULL时使用系统单调时钟
+    time_t now_us;       // 最近一次刷新得到的时间（微秒）
+} net_clock;
+
+/**
+ * @brief 轮询方式及其状态
+ *
+ */
+static struct {
+    net_poll_mode_t mode;  // 轮询方式
+    int busy_us;           // 混合模式下收到数据后继续忙轮询的时间（微秒）
+    int epfd;              // 等待网卡可读的epoll描述符，不支持时为-1，退化为忙轮询
+    time_t last_rx_us;     // 最近一次收到数据的时间（微秒）
+} net_poller = {.mode = NET_POLL_HYBRID, .busy_us = NET_POLL_BUSY_US, .epfd = -1};
+
+/**
+ * @brief 为事件轮询注册网卡的文件描述符
+ *
+ */
+static void net_poll_init() {
+#ifdef __linux__
+    int fd = driver_fd();
+    if (fd < 0)
+        return;
+    if ((net_poller.epfd = epoll_create1(0)) < 0) {
+        fprintf(stderr, "Error in epoll_create1, fall back to busy polling.\n");
+        return;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    if (epoll_ctl(net_poller.epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fprintf(stderr, "Error in epoll_ctl, fall back to busy polling.\n");
+        close(net_poller.epfd);
+        net_poller.epfd = -1;
+    }
+#endif
+}
+
 /**
  * @brief 初始化协议栈
  *
  */
 int net_init() {
-    map_init(&net_table, sizeof(uint16_t), sizeof(net_handler_t), 0, 0, NULL, NULL);
+    net_clock_update();
+    map_init(&net_table, sizeof(uint16_t), sizeof(net_handler_t), 0, 0, NULL, NULL, NULL, NULL, NULL);
     if (driver_open() == -1)
         return -1;
+    net_poll_init();
+    timer_init();
     ethernet_init();
     arp_init();
+    route_init();
     ip_init();
 #ifdef ICMP
     icmp_init();
@@ -55,6 +117,30 @@ int net_init() {
     return 0;
 }
 
+/**
+ * @brief 关闭协议栈：保存学到的arp表，关闭网卡
+ *
+ */
+void net_close() {
+    arp_save(ARP_CACHE_FILE);
+    driver_close();
+}
+
+/**
+ * @brief 设置网卡MTU，之后发送的IP数据包按新的MTU分片
+ *
+ * @param mtu 新的MTU
+ * @return int 成功为0，超出[NET_IF_MIN_MTU, NET_IF_MAX_MTU]为-1
+ */
+int net_set_mtu(uint16_t mtu) {
+    if (mtu < NET_IF_MIN_MTU || mtu > NET_IF_MAX_MTU) {
+        fprintf(stderr, "Error in net_set_mtu: %u\n", mtu);
+        return -1;
+    }
+    net_if_mtu = mtu;
+    return 0;
+}
+
 /**
  * @brief 向协议栈注册一个协议
  *
@@ -83,9 +169,90 @@ int net_in(buf_t *buf, uint16_t protocol, uint8_t *src) {
 }
 
 /**
- * @brief 一次协议栈轮询
+ * @brief 设置协议栈轮询方式
+ *
+ * @param mode 轮询方式
+ * @param busy_us 混合模式下收到数据后继续忙轮询的时间（微秒）
+ */
+void net_set_poll_mode(net_poll_mode_t mode, int busy_us) {
+    net_poller.mode = mode;
+    net_poller.busy_us = busy_us < 0 ? 0 : busy_us;
+}
+
+/**
+ * @brief 刷新协议栈时钟。Linux上CLOCK_MONOTONIC经由vDSO读取，不陷入内核
+ *
+ */
+void net_clock_update() {
+    if (net_clock.source) {
+        net_clock.now_us = net_clock.source() * 1000;
+        return;
+    }
+#ifdef _WIN32
+    net_clock.now_us = (time_t)GetTickCount64() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    net_clock.now_us = (time_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief 获取协议栈时钟的当前时间，即最近一次刷新时的时间，不产生系统调用
+ *
+ * @return time_t 单调递增的毫秒数
+ */
+time_t net_now() {
+    return net_clock.now_us / 1000;
+}
+
+/**
+ * @brief 注入时钟源，如测试中可确定重放的虚拟时钟，注入后立即刷新
+ *
+ * @param clock 时钟源，为NULL则恢复系统单调时钟
+ */
+void net_set_clock(net_clock_t clock) {
+    net_clock.source = clock;
+    net_clock_update();
+}
+
+#ifdef __linux__
+/**
+ * @brief 计算事件轮询的最长阻塞时间，不能晚于下一个待处理定时器到期
+ *
+ * @return int 毫秒
+ */
+static int net_poll_timeout() {
+    time_t next = timer_next();
+    return next >= 0 && next < NET_POLL_MAX_WAIT_MS ? next : NET_POLL_MAX_WAIT_MS;
+}
+#endif
+
+/**
+ * @brief 一次协议栈轮询。
+ * 忙轮询模式下立即返回；事件模式下没有收到数据时阻塞到网卡可读或超时；
+ * 混合模式下只有距上次收到数据超过busy_us后才阻塞，兼顾空闲时的CPU占用和负载下的延迟。
+ * 收包之后处理到期的定时器，阻塞时间不超过下一个定时器到期的时间。
+ * 本轮处理中排队的发送帧在返回或阻塞前统一发出
  *
  */
 void net_poll() {
-    ethernet_poll();
+    net_clock_update();
+    int n = ethernet_poll();
+    timer_poll();
+    driver_flush();  // 本轮产生的帧一次批量发出
+#ifdef __linux__
+    if (net_poller.mode == NET_POLL_BUSY || net_poller.epfd < 0)
+        return;
+    if (n > 0) {
+        net_poller.last_rx_us = net_clock.now_us;
+        return;
+    }
+    if (net_poller.mode == NET_POLL_HYBRID && net_clock.now_us - net_poller.last_rx_us < net_poller.busy_us)
+        return;
+    struct epoll_event ev;
+    epoll_wait(net_poller.epfd, &ev, 1, net_poll_timeout());
+#else
+    (void)n;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "route.h"
+
+#include <string.h>
+
+/**
+ * 路由表：路由条目存放在数组中，查找用的是每层8位的多分支前缀树（控制前缀扩展），
+ * 一次查找最多访问ROUTE_LEVELS个节点。路由很少修改，每次修改后整棵树重建。
+ * 在树上查找前先查按目的地址直接映射的下一跳缓存，缓存项记录路由表版本，路由修改后自动失效。
+ */
+
+typedef struct route_node  // 前缀树节点
+{
+    uint16_t child[ROUTE_FANOUT];  // 子节点下标，0为没有（根节点不会是子节点）
+    uint8_t route[ROUTE_FANOUT];   // 在本层结束、扩展到本层8位后匹配的最长路由下标+1，0为没有
+} route_node_t;
+
+typedef struct route_cache_entry  // 下一跳缓存项
+{
+    uint8_t dst_ip[NET_IP_LEN];    // 目的地址
+    uint8_t next_hop[NET_IP_LEN];  // 下一跳
+    uint32_t generation;           // 填入时的路由表版本
+} route_cache_entry_t;
+
+/**
+ * @brief 路由表
+ *
+ */
+static struct {
+    route_entry_t entries[ROUTE_MAX_ENTRIES];     // 路由条目
+    int size;                                     // 路由条数
+    route_node_t nodes[ROUTE_MAX_NODES];          // 前缀树节点，0号为根
+    int node_num;                                 // 已使用的节点数
+    route_cache_entry_t cache[ROUTE_CACHE_SIZE];  // 下一跳缓存
+    route_stats_t stats;                          // 统计
+} route_table;
+
+/**
+ * @brief 内部函数，把一条路由插入前缀树。须按前缀长度从短到长插入，长的覆盖短的
+ *
+ * @param idx 路由下标
+ * @return int 成功为0，节点用尽为-1
+ */
+static int route_insert(int idx) {
+    const route_entry_t *entry = &route_table.entries[idx];
+    route_node_t *node = &route_table.nodes[0];
+    int level = 0;
+    while (entry->prefix_len > ROUTE_STRIDE * (level + 1)) {  // 前缀在更深的层结束
+        uint8_t byte = entry->prefix[level];
+        if (!node->child[byte]) {
+            if (route_table.node_num == ROUTE_MAX_NODES)
+                return -1;
+            memset(&route_table.nodes[route_table.node_num], 0, sizeof(route_node_t));
+            node->child[byte] = route_table.node_num++;
+        }
+        node = &route_table.nodes[node->child[byte]];
+        level++;
+    }
+    int bits = entry->prefix_len - ROUTE_STRIDE * level;  // 本层中前缀剩余的位数，0~8
+    int first = entry->prefix[level] & ~((ROUTE_FANOUT - 1) >> bits);
+    for (int i = first; i < first + (ROUTE_FANOUT >> bits); i++)
+        node->route[i] = idx + 1;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，路由表修改后重建前缀树，并使下一跳缓存失效
+ *
+ * @return int 成功为0，节点用尽为-1
+ */
+static int route_rebuild() {
+    route_table.stats.generation++;
+    memset(&route_table.nodes[0], 0, sizeof(route_node_t));
+    route_table.node_num = 1;
+    for (int len = 0; len <= NET_IP_LEN * 8; len++)
+        for (int i = 0; i < route_table.size; i++)
+            if (route_table.entries[i].prefix_len == len && route_insert(i) < 0) {
+                fprintf(stderr, "Error in route_rebuild: out of trie nodes.\n");
+                return -1;
+            }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，在前缀树中查找最长前缀匹配的路由
+ *
+ * @param dst_ip 目的地址
+ * @return const route_entry_t* 匹配的路由，没有为NULL
+ */
+static const route_entry_t *route_match(const uint8_t *dst_ip) {
+    const route_node_t *node = &route_table.nodes[0];
+    int best = 0;
+    for (int level = 0; level < ROUTE_LEVELS; level++) {
+        uint8_t byte = dst_ip[level];
+        if (node->route[byte])
+            best = node->route[byte];
+        if (!node->child[byte])
+            break;
+        node = &route_table.nodes[node->child[byte]];
+    }
+    return best ? &route_table.entries[best - 1] : NULL;
+}
+
+/**
+ * @brief 添加或替换一条路由
+ *
+ * @param prefix 目的网络，主机位会被清零
+ * @param prefix_len 前缀长度，0为默认路由
+ * @param gateway 下一跳，为NULL或0.0.0.0则直连
+ * @return int 成功为0，失败为-1
+ */
+int route_add(const uint8_t *prefix, uint8_t prefix_len, const uint8_t *gateway) {
+    if (prefix_len > NET_IP_LEN * 8) {
+        fprintf(stderr, "Error in route_add: prefix length %u.\n", prefix_len);
+        return -1;
+    }
+    route_entry_t entry = {.prefix_len = prefix_len};
+    for (int i = 0; i < NET_IP_LEN; i++) {
+        int bits = prefix_len - 8 * i;
+        entry.prefix[i] = bits >= 8 ? prefix[i] : bits > 0 ? prefix[i] & (0xFF << (8 - bits)) : 0;
+    }
+    if (gateway)
+        memcpy(entry.gateway, gateway, NET_IP_LEN);
+
+    int i;
+    for (i = 0; i < route_table.size; i++)
+        if (route_table.entries[i].prefix_len == prefix_len && !memcmp(route_table.entries[i].prefix, entry.prefix, NET_IP_LEN))
+            break;
+    if (i == ROUTE_MAX_ENTRIES) {
+        fprintf(stderr, "Error in route_add: routing table full.\n");
+        return -1;
+    }
+    route_entry_t old = route_table.entries[i];
+    int replaced = i < route_table.size;
+    route_table.entries[i] = entry;
+    if (!replaced)
+        route_table.size++;
+    if (route_rebuild() < 0) {  // 恢复修改前的路由表，原来的树放得下，重建不会再失败
+        if (replaced)
+            route_table.entries[i] = old;
+        else
+            route_table.size--;
+        route_rebuild();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 删除一条路由
+ *
+ * @param prefix 目的网络
+ * @param prefix_len 前缀长度
+ * @return int 成功为0，没有该路由为-1
+ */
+int route_delete(const uint8_t *prefix, uint8_t prefix_len) {
+    for (int i = 0; i < route_table.size; i++) {
+        route_entry_t *entry = &route_table.entries[i];
+        if (entry->prefix_len != prefix_len || ip_prefix_match(entry->prefix, (uint8_t *)prefix) < prefix_len)
+            continue;
+        *entry = route_table.entries[--route_table.size];
+        route_rebuild();
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief 查找发往目的地址的数据包的下一跳。先查下一跳缓存，未命中再查前缀树。
+ * 没有匹配的路由时按直连处理，与没有路由表时的行为一致
+ *
+ * @param dst_ip 目的地址
+ * @return const uint8_t* 下一跳地址，直连时为目的地址本身；在下一次调用前有效
+ */
+const uint8_t *route_lookup(const uint8_t *dst_ip) {
+    route_table.stats.lookups++;
+    uint32_t key;
+    memcpy(&key, dst_ip, NET_IP_LEN);
+    route_cache_entry_t *cache = &route_table.cache[((key * 2654435761u) >> 16) & (ROUTE_CACHE_SIZE - 1)];
+    if (cache->generation == route_table.stats.generation && !memcmp(cache->dst_ip, dst_ip, NET_IP_LEN)) {
+        route_table.stats.cache_hits++;
+        return cache->next_hop;
+    }
+
+    const route_entry_t *entry = route_match(dst_ip);
+    static const uint8_t any[NET_IP_LEN];
+    memcpy(cache->dst_ip, dst_ip, NET_IP_LEN);
+    if (entry && memcmp(entry->gateway, any, NET_IP_LEN))
+        memcpy(cache->next_hop, entry->gateway, NET_IP_LEN);
+    else
+        memcpy(cache->next_hop, dst_ip, NET_IP_LEN);
+    if (!entry)
+        route_table.stats.misses++;
+    cache->generation = route_table.stats.generation;
+    return cache->next_hop;
+}
+
+/**
+ * @brief 打印路由表
+ *
+ */
+void route_print() {
+    printf("===ROUTE===\n");
+    for (int i = 0; i < route_table.size; i++) {
+        route_entry_t *entry = &route_table.entries[i];
+        printf("%s/%u", iptos(entry->prefix), entry->prefix_len);
+        printf(" via %s\n", iptos(entry->gateway));
+    }
+    printf("===========\n");
+}
+
+/**
+ * @brief 获取路由查找的统计
+ *
+ * @return const route_stats_t* 统计信息
+ */
+const route_stats_t *route_get_stats() {
+    return &route_table.stats;
+}
+
+/**
+ * @brief 初始化路由表，添加网卡所在子网的直连路由和默认路由
+ *
+ */
+void route_init() {
+    memset(&route_table, 0, sizeof(route_table));
+    route_table.stats.generation = 1;  // 缓存项初始版本为0，全部无效
+    uint8_t netmask[NET_IP_LEN] = NET_IF_NETMASK;
+    uint8_t gateway[NET_IP_LEN] = NET_IF_GATEWAY;
+    static const uint8_t any[NET_IP_LEN];
+    uint8_t all_ones[NET_IP_LEN] = {0xFF, 0xFF, 0xFF, 0xFF};
+    route_add(net_if_ip, ip_prefix_match(netmask, all_ones), NULL);
+    if (memcmp(gateway, any, NET_IP_LEN))
+        route_add(any, 0, gateway);
+}
@@ -1,7 +1,9 @@
 #include "tcp.h"
 
+#include "driver.h"
 #include "icmp.h"
 #include "ip.h"
+#include "timer.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -49,6 +51,16 @@ static inline uint32_t tcp_generate_initial_seq() {
 void tcp_rst(tcp_conn_t *tcp_conn) {
     memset(tcp_conn, 0, sizeof(tcp_conn_t));
     tcp_conn->state = TCP_STATE_LISTEN;
+    tcp_conn->rto = TCP_RETRANSMISSON_TIMEOUT * 1000;
+}
+
+/**
+ * @brief 连接表的值析构函数，释放连接的发送缓冲区
+ *
+ * @param tcp_conn 被删除的连接
+ */
+static void tcp_conn_free(void *tcp_conn) {
+    buf_unref(&((tcp_conn_t *)tcp_conn)->snd_buf);
 }
 
 /**
@@ -90,15 +102,271 @@ static inline tcp_conn_t *tcp_get_connection(uint8_t remote_ip[NET_IP_LEN], uint
 }
 
 /**
- * @brief 关闭一个 TCP 连接
+ * @brief 关闭一个 TCP 连接，并以 tcp_conn 为NULL通知端口的处理程序，使应用释放为连接保存的状态
  *
  * @param remote_ip
  * @param remote_port
  * @param host_port
  */
 static inline void tcp_close_connection(uint8_t remote_ip[NET_IP_LEN], uint16_t remote_port, uint16_t host_port) {
-    tcp_key_t key = generate_tcp_key(remote_ip, remote_port, host_port);
+    tcp_key_t key = generate_tcp_key(remote_ip, remote_port, host_port);  // 参数可能指向连接表中的键，删除前先拷贝
     map_delete(&tcp_conn_table, &key);
+    tcp_handler_t *handler = map_get(&tcp_handler_table, &key.host_port);
+    if (handler)
+        (*handler)(NULL, NULL, 0, key.remote_ip, key.remote_port);
+}
+
+/**
+ * @brief 到期时处理各连接的重传定时
+ *
+ */
+static timer_event_t tcp_rto_timer;
+
+/**
+ * @brief 在deadline时处理重传，已有更早的定时则不变
+ *
+ * @param deadline 时间，net_now()的毫秒数
+ */
+static void tcp_rto_schedule(time_t deadline) {
+    if (!timer_pending(&tcp_rto_timer) || tcp_rto_timer.expires > deadline)
+        timer_add(&tcp_rto_timer, deadline - net_now());
+}
+
+/**
+ * @brief 计算发往目的地址的报文段最多携带的数据长度。按路径MTU切分，避免IP分片；可交给后端分段（TSO）时不切分
+ *
+ * @param dst_ip 目的ip地址
+ * @return size_t 最大报文段长度
+ */
+static size_t tcp_mss(uint8_t *dst_ip) {
+    uint16_t mtu = ip_pmtu(dst_ip);
+    if ((driver_offload() & DRIVER_OFFLOAD_TSO) && mtu == net_if_mtu)
+        return UINT16_MAX - sizeof(ip_hdr_t) - sizeof(tcp_hdr_t);
+    return mtu - sizeof(ip_hdr_t) - sizeof(tcp_hdr_t);
+}
+
+/**
+ * @brief 把发送缓冲区中的一段数据作为一个报文段发出，序列号由其在缓冲区中的位置决定
+ *
+ * @param tcp_conn 连接
+ * @param offset   数据相对 snd_una 的偏移
+ * @param len      数据长度
+ * @param src_port 源端口号
+ * @param dst_ip   目的ip地址
+ * @param dst_port 目的端口号
+ */
+static void tcp_send_segment(tcp_conn_t *tcp_conn, size_t offset, size_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    static buf_t tx_buf;  // 各报文段复用，未被缓存时不重新分配
+    buf_init(&tx_buf, len);
+    uint8_t *data = tcp_conn->snd_buf.data + tcp_conn->snd_off + offset;
+    if (!(driver_offload() & DRIVER_OFFLOAD_CSUM)) {  // 拷贝时顺带累加负载，tcp_out只需再累加头部
+        tx_buf.csum = checksum_copy(tx_buf.data, data, len);
+        tx_buf.csum_len = len;
+        tx_buf.flags |= BUF_CSUM_PAYLOAD;
+    } else
+        memcpy(tx_buf.data, data, len);
+    uint32_t seq = tcp_conn->seq;
+    tcp_conn->seq = tcp_conn->snd_una + offset;
+    tcp_out(tcp_conn, &tx_buf, src_port, dst_ip, dst_port, TCP_FLG_ACK /* 顺带 ACK */);
+    tcp_conn->seq = seq;
+}
+
+/**
+ * @brief 在对端窗口允许的范围内发送缓冲区中未发送的数据，并在有数据等待确认（或等待窗口打开）时启动重传定时
+ *
+ * @param tcp_conn 连接
+ * @param src_port 源端口号
+ * @param dst_ip   目的ip地址
+ * @param dst_port 目的端口号
+ * @return int     发出的报文段数
+ */
+static int tcp_output(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    // 还没有建立连接，或已经发出 FIN（其序号紧跟在已发送的数据之后）时不再发送新数据
+    if (tcp_conn->state < TCP_STATE_ESTABLISHED || tcp_conn->seq != tcp_conn->snd_una + tcp_conn->snd_sent)
+        return 0;
+    size_t mss = tcp_mss(dst_ip);
+    int n = 0;
+    while (tcp_conn->snd_sent < tcp_conn->snd_len && tcp_conn->snd_sent < tcp_conn->snd_wnd) {
+        size_t len = tcp_conn->snd_len - tcp_conn->snd_sent;
+        if (len > tcp_conn->snd_wnd - tcp_conn->snd_sent)
+            len = tcp_conn->snd_wnd - tcp_conn->snd_sent;
+        if (len > mss)
+            len = mss;
+        if (!tcp_conn->rtt_timing) {  // 每次只对一个报文段计时
+            tcp_conn->rtt_timing = 1;
+            tcp_conn->rtt_seq = tcp_conn->snd_una + tcp_conn->snd_sent + len;
+            tcp_conn->rtt_start = net_now();
+        }
+        tcp_send_segment(tcp_conn, tcp_conn->snd_sent, len, src_port, dst_ip, dst_port);
+        tcp_conn->snd_sent += len;
+        tcp_conn->seq += len;
+        n++;
+    }
+    // 窗口为0时也启动定时，到期后发送窗口探测
+    if (tcp_conn->snd_len && !tcp_conn->rto_deadline) {
+        tcp_conn->rto_deadline = net_now() + tcp_conn->rto;
+        tcp_rto_schedule(tcp_conn->rto_deadline);
+    }
+    return n;
+}
+
+/**
+ * @brief 重传最早的未确认数据，最多一个报文段
+ *
+ * @param tcp_conn 连接
+ * @param src_port 源端口号
+ * @param dst_ip   目的ip地址
+ * @param dst_port 目的端口号
+ */
+static void tcp_retransmit(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    size_t len = tcp_mss(dst_ip);
+    if (len > tcp_conn->snd_sent)
+        len = tcp_conn->snd_sent;
+    tcp_conn->rtt_timing = 0;  // Karn算法：不用重传的报文段测量 RTT
+    tcp_send_segment(tcp_conn, 0, len, src_port, dst_ip, dst_port);
+}
+
+/**
+ * @brief 发送（或重传）FIN，须在缓冲的数据都已确认后调用，FIN 的序列号即 snd_una。
+ * 与数据一样由重传定时负责重传，直到对端确认
+ *
+ * @param tcp_conn 连接
+ * @param src_port 源端口号
+ * @param dst_ip   目的ip地址
+ * @param dst_port 目的端口号
+ */
+static void tcp_send_fin(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    static buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    tcp_conn->seq = tcp_conn->snd_una;
+    tcp_out(tcp_conn, &tx_buf, src_port, dst_ip, dst_port, TCP_FLG_ACK | TCP_FLG_FIN);
+    tcp_conn->seq = tcp_conn->snd_una + 1;
+    if (!tcp_conn->rto_deadline) {
+        tcp_conn->rto_deadline = net_now() + tcp_conn->rto;
+        tcp_rto_schedule(tcp_conn->rto_deadline);
+    }
+}
+
+/**
+ * @brief 用一个 RTT 样本更新 SRTT、RTTVAR 和 RTO（RFC 6298）
+ *
+ * @param tcp_conn 连接
+ * @param rtt      RTT 样本（毫秒）
+ */
+static void tcp_rtt_update(tcp_conn_t *tcp_conn, time_t rtt) {
+    if (!tcp_conn->srtt && !tcp_conn->rttvar) {  // 第一个样本
+        tcp_conn->srtt = rtt;
+        tcp_conn->rttvar = rtt / 2;
+    } else {
+        time_t delta = tcp_conn->srtt > rtt ? tcp_conn->srtt - rtt : rtt - tcp_conn->srtt;
+        tcp_conn->rttvar = (3 * tcp_conn->rttvar + delta) / 4;
+        tcp_conn->srtt = (7 * tcp_conn->srtt + rtt) / 8;
+    }
+    time_t rto = tcp_conn->srtt + (4 * tcp_conn->rttvar > 1 ? 4 * tcp_conn->rttvar : 1);  // 时钟粒度为1毫秒
+    tcp_conn->rto = rto < TCP_RTO_MIN_MS ? TCP_RTO_MIN_MS : rto > TCP_RTO_MAX_MS ? TCP_RTO_MAX_MS : rto;
+}
+
+/**
+ * @brief 处理收到的确认：释放已确认的数据，测量 RTT，更新重传定时和对端窗口，
+ * 收到足够多的重复 ACK 时快速重传，然后发送窗口内新允许的数据。
+ * 缓冲区腾出空间时通知曾被阻塞的应用；对端已关闭而数据都已确认时发送推迟的 FIN
+ *
+ * @param tcp_conn    连接
+ * @param hdr         收到的报文头
+ * @param data_len    收到的报文携带的数据长度
+ * @param host_port   本机端口号
+ * @param remote_ip   对端ip地址
+ * @param remote_port 对端端口号
+ */
+static void tcp_ack(tcp_conn_t *tcp_conn, tcp_hdr_t *hdr, size_t data_len, uint16_t host_port, uint8_t *remote_ip, uint16_t remote_port) {
+    uint32_t ack = swap32(hdr->ack);
+    uint32_t wnd = swap16(hdr->win);
+    int32_t acked = ack - tcp_conn->snd_una;
+    if (acked > 0 && (int32_t)(ack - tcp_conn->seq) <= 0) {
+        size_t n = (size_t)acked < tcp_conn->snd_sent ? (size_t)acked : tcp_conn->snd_sent;  // FIN 占的序号不在缓冲区中
+        tcp_conn->snd_off += n;
+        tcp_conn->snd_len -= n;
+        tcp_conn->snd_sent -= n;
+        tcp_conn->snd_una += n;
+        if (!tcp_conn->snd_len)
+            tcp_conn->snd_off = 0;
+        if (tcp_conn->rtt_timing && (int32_t)(ack - tcp_conn->rtt_seq) >= 0) {
+            tcp_rtt_update(tcp_conn, net_now() - tcp_conn->rtt_start);
+            tcp_conn->rtt_timing = 0;
+        }
+        tcp_conn->dup_acks = 0;
+        tcp_conn->retransmits = 0;
+        tcp_conn->rto_deadline = 0;  // 所有数据都已确认则停止定时，否则由tcp_output重新开始计时
+    } else if (acked == 0 && tcp_conn->snd_sent && !data_len && !(hdr->flags & (TCP_FLG_SYN | TCP_FLG_FIN)) && wnd == tcp_conn->snd_wnd) {
+        if (++tcp_conn->dup_acks == TCP_DUP_ACK_THRESHOLD)
+            tcp_retransmit(tcp_conn, host_port, remote_ip, remote_port);
+    }
+    if (!wnd)
+        tcp_conn->retransmits = 0;  // 对端仍在响应窗口探测，不放弃连接
+    tcp_conn->snd_wnd = wnd;
+    tcp_output(tcp_conn, host_port, remote_ip, remote_port);
+    if (acked > 0 && tcp_conn->snd_blocked) {
+        tcp_handler_t *handler = map_get(&tcp_handler_table, &host_port);
+        tcp_conn->snd_blocked = 0;
+        if (handler) {
+            (*handler)(tcp_conn, NULL, 0, remote_ip, remote_port);
+            tcp_conn->not_send_empty_ack = 0;  // 这时发出的数据没有确认本报文携带的数据
+        }
+    }
+    if (tcp_conn->state == TCP_STATE_CLOSE_WAIT && !tcp_conn->snd_len) {
+        tcp_send_fin(tcp_conn, host_port, remote_ip, remote_port);
+        tcp_conn->state = TCP_STATE_LAST_ACK;
+    }
+}
+
+static time_t tcp_rto_next;  // 一轮处理中剩下的最早的重传时间，-1为没有
+
+/**
+ * @brief 处理一个连接的重传定时：到期则重传最早的未确认数据（窗口为0时发送1字节的窗口探测），RTO加倍；
+ * 连续超时次数过多则关闭连接
+ *
+ * @param key       连接的键
+ * @param value     连接
+ * @param timestamp 更新时间
+ */
+static void tcp_rto_entry(void *key, void *value, time_t *timestamp) {
+    tcp_key_t *tcp_key = key;
+    tcp_conn_t *tcp_conn = value;
+    if (!tcp_conn->rto_deadline)
+        return;
+    if (tcp_conn->rto_deadline <= net_now()) {
+        if (tcp_conn->retransmits++ == TCP_MAX_RETRANSMITS) {  // 对端长时间无响应，放弃连接
+            tcp_close_connection(tcp_key->remote_ip, tcp_key->remote_port, tcp_key->host_port);
+            return;
+        }
+        tcp_conn->rto = 2 * tcp_conn->rto < TCP_RTO_MAX_MS ? 2 * tcp_conn->rto : TCP_RTO_MAX_MS;
+        if (tcp_conn->snd_sent) {
+            tcp_retransmit(tcp_conn, tcp_key->host_port, tcp_key->remote_ip, tcp_key->remote_port);
+        } else if (tcp_conn->snd_len && tcp_conn->seq == tcp_conn->snd_una) {
+            tcp_conn->rtt_timing = 0;
+            tcp_send_segment(tcp_conn, 0, 1, tcp_key->host_port, tcp_key->remote_ip, tcp_key->remote_port);
+            tcp_conn->snd_sent = 1;
+            tcp_conn->seq++;
+        } else if (tcp_conn->state == TCP_STATE_LAST_ACK) {  // FIN 未被确认
+            tcp_send_fin(tcp_conn, tcp_key->host_port, tcp_key->remote_ip, tcp_key->remote_port);
+        }
+        tcp_conn->rto_deadline = tcp_conn->snd_len || tcp_conn->state == TCP_STATE_LAST_ACK ? net_now() + tcp_conn->rto : 0;
+        if (!tcp_conn->rto_deadline)
+            return;
+    }
+    if (tcp_rto_next < 0 || tcp_conn->rto_deadline < tcp_rto_next)
+        tcp_rto_next = tcp_conn->rto_deadline;
+}
+
+/**
+ * @brief 定时器回调，处理到期的重传，并按剩下最早的时间重新定时
+ *
+ */
+static void tcp_rto_expire(void *arg) {
+    tcp_rto_next = -1;
+    map_foreach(&tcp_conn_table, tcp_rto_entry);
+    if (tcp_rto_next >= 0)
+        tcp_rto_schedule(tcp_rto_next);
 }
 
 /* =============================== TOOLS =============================== */
@@ -131,10 +399,22 @@ void tcp_out(tcp_conn_t *tcp_conn, buf_t *buf, uint16_t src_port, uint8_t *dst_i
     tcp_header->flags = flags;  // flags肯定不是我们构造tcp报头的时候能知道的，肯定要上层提供
     // checksum need to set
     tcp_header->checksum16 = 0;
-    uint16_t jiaoyanhe =  transport_checksum(NET_PROTOCOL_TCP, buf, net_if_ip, dst_ip);  // 计算校验和
-    tcp_header->checksum16 = jiaoyanhe;
+    // 驱动后端支持卸载时只填伪头部和，超过MTU的报文交给后端分段
+    int offload = driver_offload();
+    uint16_t mtu = ip_pmtu(dst_ip);  // 路径MTU降低后不交给后端分段，由IP层按路径MTU分片
+    buf->flags &= ~(BUF_CSUM_PARTIAL | BUF_GSO);
+    if ((offload & DRIVER_OFFLOAD_TSO) && buf->len + sizeof(ip_hdr_t) > mtu && mtu == net_if_mtu && buf->len + sizeof(ip_hdr_t) <= UINT16_MAX)
+        buf->flags |= BUF_GSO;
+    if ((offload & DRIVER_OFFLOAD_CSUM) && ((buf->flags & BUF_GSO) || buf->len + sizeof(ip_hdr_t) <= mtu)) {
+        tcp_header->checksum16 = transport_pseudo_checksum(NET_PROTOCOL_TCP, buf->len, net_if_ip, dst_ip);
+        buf->flags |= BUF_CSUM_PARTIAL;
+    } else {
+        uint16_t jiaoyanhe =  transport_checksum(NET_PROTOCOL_TCP, buf, net_if_ip, dst_ip);  // 计算校验和
+        tcp_header->checksum16 = jiaoyanhe;
+    }
+    buf->flags &= ~BUF_CSUM_PAYLOAD;
 
-    ip_out(buf, dst_ip, NET_PROTOCOL_TCP);  // 调用ip_out函数发送数据包
+    ip_out_cached(buf, dst_ip, NET_PROTOCOL_TCP, &tcp_conn->next_hop);  // 调用ip_out函数发送数据包
     /* =============================== TODO 1 END =============================== */
 }
 
@@ -153,26 +433,30 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
     tcp_hdr_t *hdr = (tcp_hdr_t *)buf->data;
 
     // 校验checksum
-    uint16_t checksum = hdr->checksum16;
-    hdr->checksum16 = 0;
-    if (transport_checksum(NET_PROTOCOL_TCP, buf, src_ip, net_if_ip) != checksum)
-        return;
+    if (!(buf->flags & BUF_CSUM_VALID)) {  // 驱动后端已校验过的跳过
+        if (transport_checksum(NET_PROTOCOL_TCP, buf, src_ip, net_if_ip) != 0)  // 连同校验和字段一起计算，不改写借用的数据包
+            return;
+    }
 
     uint8_t *remote_ip = src_ip;
     uint16_t remote_port = swap16(hdr->src_port16);
     uint16_t host_port = swap16(hdr->dst_port16);
-    tcp_conn_t *tcp_conn = tcp_get_connection(remote_ip, remote_port, host_port, true);
-
     uint8_t recv_flags = hdr->flags;
-    // 收到RST，关闭 TCP 连接
+    // 收到RST，关闭 TCP 连接；没有这个连接时忽略，不为它新建连接
     if (TCP_FLG_ISSET(recv_flags, TCP_FLG_RST)) {
-        tcp_close_connection(remote_ip, remote_port, host_port);
+        if (tcp_get_connection(remote_ip, remote_port, host_port, false))
+            tcp_close_connection(remote_ip, remote_port, host_port);
         return;
     }
+    tcp_conn_t *tcp_conn = tcp_get_connection(remote_ip, remote_port, host_port, true);
 
     uint32_t remote_seq = swap32(hdr->seq);  // 注意，头部的seq和这边是换了字节序的
     uint32_t tcp_hdr_sz = (hdr->doff >> 4) * 4;
 
+    // 处理确认，释放已确认的数据，并按对端窗口继续发送
+    if (TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK) && tcp_conn->state != TCP_STATE_LISTEN)
+        tcp_ack(tcp_conn, hdr, buf->len - tcp_hdr_sz, host_port, remote_ip, remote_port);
+
     /* =============================== TODO 2 BEGIN =============================== */
     /* Step1 ：根据接收包数据更新当前TCP连接内部状态，并填写回复报文的标志部分。 */
 
@@ -193,6 +477,8 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
             // TODO: 填写回复标志 send_flags
             send_flags = TCP_FLG_SYN | TCP_FLG_ACK;  // 回复 SYN-ACK 报文
             tcp_conn->ack = remote_seq + 1;
+            tcp_conn->snd_una = tcp_conn->seq + 1;  // SYN 占一个序号，发送缓冲区的数据从其后开始
+            tcp_conn->snd_wnd = swap16(hdr->win);
 
             // TODO: 进行状态转移
             tcp_conn->state = TCP_STATE_SYN_RECEIVED;
@@ -230,22 +516,33 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
             // tcp_out(tcp_conn, &txbuf, host_port, remote_ip, remote_port, send_flags);
 
             // TODO: 如果收到 FIN 报文，则增加 send_flags 相应标志位，并且进行状态转移
+            // 我们的 FIN 要排在缓冲的数据之后，等数据都被确认后再发（见Step3和tcp_ack）
             if (TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN)) {
-                send_flags = TCP_FLG_ACK | TCP_FLG_FIN;
-                tcp_conn->state = TCP_STATE_LAST_ACK;  // 状态转移到 CLOSE WAIT(和LST ACK合并成一个状态)
+                send_flags = TCP_FLG_ACK;
+                tcp_conn->state = TCP_STATE_CLOSE_WAIT;
             }
             break;
 
+        case TCP_STATE_CLOSE_WAIT:
+            // 对端重传的 FIN，说明我们的 ACK 丢了，再确认一次
+            if (TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN))
+                send_flags = TCP_FLG_ACK;
+            break;
+
         case TCP_STATE_LAST_ACK:
             // TODO: 仅在收到确认报文时（ACK报文）才做出处理，否则直接返回
             if (!TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK))
                 return;
-            
+            if (TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN) && swap32(hdr->ack) != tcp_conn->seq) {  // 对端重传的 FIN，连同我们的 FIN 再确认一次
+                tcp_send_fin(tcp_conn, host_port, remote_ip, remote_port);
+                return;
+            }
+            if (swap32(hdr->ack) != tcp_conn->seq)  // 只有确认了 FIN 的 ACK 才关闭，之前的 ACK 确认的是数据
+                return;
 
             // TODO: 关闭 TCP 连接
             tcp_close_connection(remote_ip, remote_port, host_port);
-
-            break;
+            return;
 
         default:
             printf("do not support state %d\n", tcp_conn->state);
@@ -269,6 +566,13 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
     
 
     /* Step3 ：调用tcp_out()发送回复报文，更新TCP连接序列号。 */
+    // 对端已关闭，缓冲的数据（含应用刚放入的）都已确认时发送 FIN，同时确认对端的 FIN
+    if (tcp_conn->state == TCP_STATE_CLOSE_WAIT && !tcp_conn->snd_len) {
+        tcp_send_fin(tcp_conn, host_port, remote_ip, remote_port);
+        tcp_conn->state = TCP_STATE_LAST_ACK;
+        tcp_conn->not_send_empty_ack = 0;
+        return;
+    }
     // 如果无需回复，则接收逻辑结束
     if (send_flags == 0)
         return;
@@ -296,37 +600,50 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
 }
 
 /**
- * @brief 发送一个 TCP 包
+ * @brief 发送一个 TCP 包。数据先放入连接的发送缓冲区，再在对端窗口允许的范围内发出，
+ * 确认前一直保留以便重传
  *
  * @param tcp_conn  指向当前 TCP 连接的指针
- * @param data      要发送的数据
+ * @param data      要发送的数据，为NULL则发送全0
  * @param len       数据长度
  * @param src_port  源端口号
  * @param dst_ip    目的ip地址
  * @param dst_port  目的端口号
+ * @return int      放入发送缓冲区的字节数，缓冲区满时少于len，余下的数据由应用在处理程序收到有空间的通知（data为NULL）后再发；失败为-1
  */
-void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+int tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
     // 检查payload长度是否合法
     if (len > TCP_MAX_WINDOW_SIZE) {
         printf("package is too big [max value = %d, current value = %d], please split it into small pieces in the user functions.\n", TCP_MAX_WINDOW_SIZE, len);
-        return;
+        return -1;
     }
     if (len == 0) {
         printf("no payload to send, skipping transmission.\n");
-        return;
+        return 0;
     }
+    if (!tcp_conn->snd_buf.block && buf_init(&tcp_conn->snd_buf, TCP_SEND_BUF_SIZE) < 0)
+        return -1;
 
-    // 发送数据包
-    buf_t tx_buf;
-    buf_init(&tx_buf, len);
+    // 放入发送缓冲区，尾部空间不够时把缓冲的数据移到开头
+    if (len > TCP_SEND_BUF_SIZE - tcp_conn->snd_len) {
+        len = TCP_SEND_BUF_SIZE - tcp_conn->snd_len;
+        tcp_conn->snd_blocked = 1;  // 有数据被确认、腾出空间时通知应用
+    }
+    if (tcp_conn->snd_off + tcp_conn->snd_len + len > TCP_SEND_BUF_SIZE) {
+        memmove(tcp_conn->snd_buf.data, tcp_conn->snd_buf.data + tcp_conn->snd_off, tcp_conn->snd_len);
+        tcp_conn->snd_off = 0;
+    }
+    uint8_t *tail = tcp_conn->snd_buf.data + tcp_conn->snd_off + tcp_conn->snd_len;
     if (data)
-        memcpy(tx_buf.data, data, len);
-    tcp_out(tcp_conn, &tx_buf, src_port, dst_ip, dst_port, TCP_FLG_ACK /* 顺带 ACK */);
+        memcpy(tail, data, len);
+    else
+        memset(tail, 0, len);
+    tcp_conn->snd_len += len;
 
-    // 更新序列号
-    tcp_conn->seq += bytes_in_flight(len, 0);
-    // 标注已 ACK
-    tcp_conn->not_send_empty_ack = 1;
+    // 发送数据包
+    if (tcp_output(tcp_conn, src_port, dst_ip, dst_port))
+        tcp_conn->not_send_empty_ack = 1;  // 标注已 ACK
+    return len;
 }
 
 /**
@@ -334,8 +651,9 @@ void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_po
  *
  */
 void tcp_init() {
-    map_init(&tcp_handler_table, sizeof(uint16_t), sizeof(tcp_handler_t), 0, 0, NULL, NULL);
-    map_init(&tcp_conn_table, sizeof(tcp_key_t), sizeof(tcp_conn_t), 0, 0, NULL, NULL);
+    map_init(&tcp_handler_table, sizeof(uint16_t), sizeof(tcp_handler_t), 0, 0, NULL, NULL, NULL, NULL, NULL);
+    map_init(&tcp_conn_table, sizeof(tcp_key_t), sizeof(tcp_conn_t), 0, 0, NULL, NULL, NULL, tcp_conn_free, NULL);
+    timer_setup(&tcp_rto_timer, tcp_rto_expire, NULL);
     net_add_protocol(NET_PROTOCOL_TCP, tcp_in);
     // 初始化随机数种子，为生成 TCP 初始序列号提供支持
     srand(time(NULL));
@@ -0,0 +1,231 @@
+#include "timer.h"
+
+#include "net.h"
+
+#include <string.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN ((time_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))  // 可定时的最长毫秒数，更长的定时到期前会被重新放入
+
+/**
+ * @brief 分层时间轮。第0层每格1毫秒，第n层每格是第n-1层转一圈的时间；
+ * 定时器按距到期的时间放到对应层，低层转完一圈时把高层当前格的定时器下放（cascade），
+ * 加入与取消都是O(1)。每层一个占用位图，轮询时直接跳过空的格
+ *
+ */
+static struct {
+    time_t now;                                                      // 下一个要处理的毫秒
+    size_t count;                                                    // 等待中的定时器个数
+    uint64_t bitmap[TIMER_WHEEL_LEVELS];                             // 每层非空槽位的位图
+    timer_event_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // 每个槽位的定时器链表
+} timer_wheel;
+
+/**
+ * @brief 内部函数，按到期时间把定时器放入时间轮
+ *
+ * @param timer 要放入的定时器
+ */
+static void timer_link(timer_event_t *timer) {
+    time_t expires = timer->expires;
+    if (expires < timer_wheel.now)
+        expires = timer_wheel.now;
+    if (expires - timer_wheel.now >= TIMER_WHEEL_SPAN)
+        expires = timer_wheel.now + TIMER_WHEEL_SPAN - 1;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && expires - timer_wheel.now >= (time_t)1 << (TIMER_WHEEL_BITS * (level + 1)))
+        level++;
+    int idx = (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer_event_t **head = &timer_wheel.slots[level][idx];
+    timer->next = *head;
+    if (timer->next)
+        timer->next->pprev = &timer->next;
+    *head = timer;
+    timer->pprev = head;
+    timer->slot = level * TIMER_WHEEL_SLOTS + idx;
+    timer_wheel.bitmap[level] |= 1ULL << idx;
+}
+
+/**
+ * @brief 内部函数，把定时器从所在链表中取出
+ *
+ * @param timer 要取出的定时器
+ */
+static void timer_unlink(timer_event_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    int level = timer->slot / TIMER_WHEEL_SLOTS;
+    int idx = timer->slot & TIMER_WHEEL_MASK;
+    if (!timer_wheel.slots[level][idx])
+        timer_wheel.bitmap[level] &= ~(1ULL << idx);
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * @brief 内部函数，取出一个槽位的整个链表，链表头改为指向局部变量，其中的定时器仍可被取消
+ *
+ * @param level 层号
+ * @param idx 层内下标
+ * @param list 出口参数，取出的链表
+ */
+static void timer_take_slot(int level, int idx, timer_event_t **list) {
+    *list = timer_wheel.slots[level][idx];
+    if (*list)
+        (*list)->pprev = list;
+    timer_wheel.slots[level][idx] = NULL;
+    timer_wheel.bitmap[level] &= ~(1ULL << idx);
+}
+
+/**
+ * @brief 内部函数，第0层转完一圈后，把高层当前格的定时器下放到低层
+ *
+ */
+static void timer_cascade() {
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        int idx = (timer_wheel.now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        timer_event_t *list;
+        timer_take_slot(level, idx, &list);
+        while (list) {
+            timer_event_t *timer = list;
+            timer_unlink(timer);
+            timer_link(timer);
+        }
+        if (idx)  // 本层没有转完一圈，更高层不需要下放
+            break;
+    }
+}
+
+/**
+ * @brief 初始化时间轮，在net_init中时钟刷新后调用
+ *
+ */
+void timer_init() {
+    memset(&timer_wheel, 0, sizeof(timer_wheel));
+    timer_wheel.now = net_now();
+}
+
+/**
+ * @brief 初始化一个定时器，之后才能加入时间轮
+ *
+ * @param timer 要初始化的定时器
+ * @param handler 到期时调用的回调函数
+ * @param arg 回调函数的参数
+ */
+void timer_setup(timer_event_t *timer, timer_handler_t handler, void *arg) {
+    memset(timer, 0, sizeof(timer_event_t));
+    timer->handler = handler;
+    timer->arg = arg;
+}
+
+/**
+ * @brief 启动定时器，已在等待的定时器重新计时
+ *
+ * @param timer 要启动的定时器
+ * @param delay_ms 距现在（net_now()）的毫秒数
+ */
+void timer_add(timer_event_t *timer, time_t delay_ms) {
+    if (timer->pprev) {
+        timer_unlink(timer);
+        timer_wheel.count--;
+    }
+    timer->expires = net_now() + (delay_ms > 0 ? delay_ms : 0);
+    timer_link(timer);
+    timer_wheel.count++;
+}
+
+/**
+ * @brief 取消定时器，未在等待则什么也不做
+ *
+ * @param timer 要取消的定时器
+ */
+void timer_cancel(timer_event_t *timer) {
+    if (!timer->pprev)
+        return;
+    timer_unlink(timer);
+    timer_wheel.count--;
+}
+
+/**
+ * @brief 判断定时器是否在等待
+ *
+ * @param timer 要判断的定时器
+ * @return int 等待中为1，否则为0
+ */
+int timer_pending(const timer_event_t *timer) {
+    return timer->pprev != NULL;
+}
+
+/**
+ * @brief 处理到当前时间（net_now()）为止到期的定时器，在net_poll中每轮调用一次。
+ * 回调中可以启动或取消任意定时器
+ *
+ */
+void timer_poll() {
+    time_t target = net_now();
+    while (timer_wheel.now <= target) {
+        if (!timer_wheel.count) {
+            timer_wheel.now = target + 1;
+            break;
+        }
+        int idx = timer_wheel.now & TIMER_WHEEL_MASK;
+        uint64_t bits = timer_wheel.bitmap[0] >> idx;
+        if (!bits) {  // 第0层这一圈已经没有定时器，直接转到下一圈
+            time_t next = (timer_wheel.now | TIMER_WHEEL_MASK) + 1;
+            if (next > target + 1) {
+                timer_wheel.now = target + 1;
+                break;
+            }
+            timer_wheel.now = next;
+            timer_cascade();
+            continue;
+        }
+        time_t tick = timer_wheel.now + __builtin_ctzll(bits);
+        if (tick > target) {
+            timer_wheel.now = target + 1;
+            break;
+        }
+        timer_event_t *expired;
+        timer_take_slot(0, tick & TIMER_WHEEL_MASK, &expired);
+        timer_wheel.now = tick + 1;  // 先前进，回调中重新启动的定时器不会落回正在处理的格
+        if (!(timer_wheel.now & TIMER_WHEEL_MASK))
+            timer_cascade();
+        while (expired) {
+            timer_event_t *timer = expired;
+            timer_unlink(timer);
+            if (timer->expires > tick) {  // 超过时间轮跨度的定时器，还没到期
+                timer_link(timer);
+                continue;
+            }
+            timer_wheel.count--;
+            timer->handler(timer->arg);
+        }
+    }
+}
+
+/**
+ * @brief 计算距下一个定时器到期的时间，供轮询决定最长阻塞多久。
+ * 高层的定时器按其下放的时间计算，可能早于真正到期的时间
+ *
+ * @return time_t 毫秒数，没有等待中的定时器为-1
+ */
+time_t timer_next() {
+    if (!timer_wheel.count)
+        return -1;
+    time_t best = -1;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!timer_wheel.bitmap[level])
+            continue;
+        int shift = TIMER_WHEEL_BITS * level;
+        time_t cur = timer_wheel.now >> shift;
+        int from = (cur & TIMER_WHEEL_MASK) + (level ? 1 : 0);  // 高层的当前格已经下放过，其中的定时器属于下一圈
+        time_t base = cur & ~(time_t)TIMER_WHEEL_MASK;
+        uint64_t bits = from < TIMER_WHEEL_SLOTS ? timer_wheel.bitmap[level] >> from : 0;
+        time_t block = bits ? base + from + __builtin_ctzll(bits) : base + TIMER_WHEEL_SLOTS + __builtin_ctzll(timer_wheel.bitmap[level]);
+        time_t deadline = block << shift;
+        if (best < 0 || deadline < best)
+            best = deadline;
+    }
+    best -= net_now();
+    return best > 0 ? best : 0;
+}
@@ -1,5 +1,6 @@
 #include "udp.h"
 
+#include "driver.h"
 #include "icmp.h"
 #include "ip.h"
 
@@ -9,6 +10,12 @@
  */
 map_t udp_table;
 
+/**
+ * @brief 按目的地址直接映射的下一跳mac缓存，相当于udp流的连接状态
+ *
+ */
+static arp_cache_t udp_flow_cache[UDP_FLOW_CACHE_SIZE];
+
 /**
  * @brief 处理一个收到的udp数据包
  *
@@ -25,14 +32,13 @@ void udp_in(buf_t *buf, uint8_t *src_ip) {
     if (buf->len < swap16(udp_hdr->total_len16)) {
         return;
     }
-    // step2 校验和验证
-    uint16_t checksum_temp = udp_hdr->checksum16;
-    udp_hdr->checksum16 = 0;
-    uint16_t checksunn = transport_checksum(NET_PROTOCOL_UDP, buf, src_ip, net_if_ip); //源和目的ip没有办法在这一层的包数据中得到；
-    if(checksunn != checksum_temp) {
-        return;  // 校验和不匹配  // debug：为什么校验和一定不一样？
+    // step2 校验和验证，驱动后端已校验过的跳过
+    if (!(buf->flags & BUF_CSUM_VALID)) {
+        // 连同校验和字段一起计算，正确时结果为0，不改写可能借用驱动内存的数据包
+        if (transport_checksum(NET_PROTOCOL_UDP, buf, src_ip, net_if_ip) != 0) { //源和目的ip没有办法在这一层的包数据中得到；
+            return;  // 校验和不匹配
+        }
     }
-    udp_hdr->checksum16 = checksum_temp;
     // step3 回调函数
     uint16_t dst_port = swap16(udp_hdr->dst_port16);
     udp_handler_t * handler = map_get(&udp_table, &dst_port);
@@ -71,11 +77,25 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
     udp_hdr->dst_port16 = swap16(dst_port);
     udp_hdr->total_len16 = swap16(buf->len);
     udp_hdr->checksum16 = 0;  //校验和先置为0
-    // step3 调用计算校验和
-    uint16_t checksunn = transport_checksum(NET_PROTOCOL_UDP, buf, net_if_ip, dst_ip);
-    udp_hdr->checksum16 = checksunn;
+    // step3 调用计算校验和，驱动后端支持卸载时只填伪头部和，超过MTU的报文交给后端分片
+    int offload = driver_offload();
+    uint16_t mtu = ip_pmtu(dst_ip);  // 路径MTU降低后不交给后端分段，由IP层按路径MTU分片
+    buf->flags &= ~(BUF_CSUM_PARTIAL | BUF_GSO);
+    if ((offload & DRIVER_OFFLOAD_UFO) && buf->len + sizeof(ip_hdr_t) > mtu && mtu == net_if_mtu && buf->len + sizeof(ip_hdr_t) <= UINT16_MAX)
+        buf->flags |= BUF_GSO;
+    if ((offload & DRIVER_OFFLOAD_CSUM) && ((buf->flags & BUF_GSO) || buf->len + sizeof(ip_hdr_t) <= mtu)) {
+        udp_hdr->checksum16 = transport_pseudo_checksum(NET_PROTOCOL_UDP, buf->len, net_if_ip, dst_ip);
+        buf->flags |= BUF_CSUM_PARTIAL;
+    } else {
+        uint16_t checksunn = transport_checksum(NET_PROTOCOL_UDP, buf, net_if_ip, dst_ip);
+        udp_hdr->checksum16 = checksunn;
+    }
+    buf->flags &= ~BUF_CSUM_PAYLOAD;
 
-    ip_out(buf, dst_ip, NET_PROTOCOL_UDP);  // 调用ip_out函数
+    uint32_t key;
+    memcpy(&key, dst_ip, NET_IP_LEN);
+    arp_cache_t *flow = &udp_flow_cache[((key * 2654435761u) >> 16) & (UDP_FLOW_CACHE_SIZE - 1)];
+    ip_out_cached(buf, dst_ip, NET_PROTOCOL_UDP, flow);  // 调用ip_out函数，同一目的地址的下一跳mac不重复查arp表
     
 }
 
@@ -84,7 +104,7 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
  *
  */
 void udp_init() {
-    map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL);
+    map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL, NULL, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_UDP, udp_in);
 }
 
@@ -119,6 +139,12 @@ void udp_close(uint16_t port) {
  */
 void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
     buf_init(&txbuf, len);
-    memcpy(txbuf.data, data, len);
+    if (driver_offload() & DRIVER_OFFLOAD_CSUM) {
+        memcpy(txbuf.data, data, len);
+    } else {  // 拷贝时顺带累加负载，udp_out只需再累加头部
+        txbuf.csum = checksum_copy(txbuf.data, data, len);
+        txbuf.csum_len = len;
+        txbuf.flags |= BUF_CSUM_PAYLOAD;
+    }
     udp_out(&txbuf, src_port, dst_ip, dst_port);
 }
\ No newline at end of file
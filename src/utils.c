@@ -62,6 +62,170 @@ uint8_t ip_prefix_match(uint8_t *ipa, uint8_t *ipb) {
     return count;
 }
 
+typedef uint64_t (*checksum_add_t)(const uint8_t *data, size_t len);
+typedef uint64_t (*checksum_copy_t)(uint8_t *dst, const uint8_t *src, size_t len);
+
+#define CHECKSUM_FLUSH 65536  // 32位和最多加这么多个16位字不会溢出，之后并入64位和
+
+/**
+ * @brief 按主机字节序逐个16位字累加，与原始实现相同的简单循环，-O3下由编译器自动向量化。
+ * copy为常量，展开后分别得到只累加和边拷贝边累加的版本
+ *
+ * @param dst 拷贝的目的地址，copy为0时不写入
+ * @param src 数据
+ * @param len 长度，须为偶数
+ * @param copy 是否同时拷贝到dst
+ * @return uint64_t 未折叠的和
+ */
+static inline __attribute__((always_inline)) uint64_t checksum_kernel_scalar(uint8_t *dst, const uint8_t *src, size_t len, int copy) {
+    uint64_t sum = 0;
+    while (len >= 2) {
+        size_t words = len / 2 < CHECKSUM_FLUSH ? len / 2 : CHECKSUM_FLUSH;
+        uint32_t part = 0;
+        for (size_t i = 0; i < words; i++) {
+            uint16_t word;
+            memcpy(&word, src + 2 * i, 2);
+            if (copy)
+                memcpy(dst + 2 * i, &word, 2);
+            part += word;
+        }
+        sum += part;
+        dst += 2 * words;
+        src += 2 * words;
+        len -= 2 * words;
+    }
+    return sum;
+}
+
+static uint64_t checksum_add_scalar(const uint8_t *data, size_t len) {
+    return checksum_kernel_scalar((uint8_t *)data, data, len, 0);
+}
+
+static uint64_t checksum_copy_scalar(uint8_t *dst, const uint8_t *src, size_t len) {
+    return checksum_kernel_scalar(dst, src, len, 1);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_X86
+#include <immintrin.h>
+
+#define CHECKSUM_SIMD_FLUSH 16384  // 32位通道每次最多加2个16位字，累加这么多轮后并入64位和，不会溢出
+
+/**
+ * @brief AVX2实现，每轮32字节
+ *
+ */
+static inline __attribute__((target("avx2"), always_inline)) uint64_t checksum_kernel_avx2(uint8_t *dst, const uint8_t *src, size_t len, int copy) {
+    uint64_t sum = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    while (len >= 32) {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t n = 0; n < CHECKSUM_SIMD_FLUSH && len >= 32; n++, dst += 32, src += 32, len -= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)src);
+            if (copy)
+                _mm256_storeu_si256((__m256i *)dst, v);
+            acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero), _mm256_unpackhi_epi16(v, zero)));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (int i = 0; i < 8; i++)
+            sum += lanes[i];
+    }
+    if (len >= 16) {  // 余下部分仍用VEX编码的128位指令，避免AVX与传统SSE指令混用的切换开销
+        __m128i v = _mm_loadu_si128((const __m128i *)src);
+        if (copy)
+            _mm_storeu_si128((__m128i *)dst, v);
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, _mm_add_epi32(_mm_unpacklo_epi16(v, _mm_setzero_si128()), _mm_unpackhi_epi16(v, _mm_setzero_si128())));
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        dst += 16;
+        src += 16;
+        len -= 16;
+    }
+    return sum + checksum_kernel_scalar(dst, src, len, copy);
+}
+
+__attribute__((target("avx2"))) static uint64_t checksum_add_avx2(const uint8_t *data, size_t len) {
+    return checksum_kernel_avx2((uint8_t *)data, data, len, 0);
+}
+
+__attribute__((target("avx2"))) static uint64_t checksum_copy_avx2(uint8_t *dst, const uint8_t *src, size_t len) {
+    return checksum_kernel_avx2(dst, src, len, 1);
+}
+#endif
+
+static uint64_t checksum_add_resolve(const uint8_t *data, size_t len);
+static uint64_t checksum_copy_resolve(uint8_t *dst, const uint8_t *src, size_t len);
+
+/**
+ * @brief 当前使用的累加实现，第一次计算校验和时根据CPUID选定
+ *
+ */
+static checksum_add_t checksum_add = checksum_add_resolve;
+static checksum_copy_t checksum_copy_add = checksum_copy_resolve;
+static checksum_impl_t checksum_impl = CHECKSUM_IMPL_AUTO;
+
+static uint64_t checksum_add_resolve(const uint8_t *data, size_t len) {
+    checksum_select(CHECKSUM_IMPL_AUTO);
+    return checksum_add(data, len);
+}
+
+static uint64_t checksum_copy_resolve(uint8_t *dst, const uint8_t *src, size_t len) {
+    checksum_select(CHECKSUM_IMPL_AUTO);
+    return checksum_copy_add(dst, src, len);
+}
+
+/**
+ * @brief 选择校验和的实现
+ *
+ * @param impl 要使用的实现，CHECKSUM_IMPL_AUTO为CPU支持的最快实现
+ * @return int 成功为0，CPU或编译器不支持为-1
+ */
+int checksum_select(checksum_impl_t impl) {
+    checksum_add_t add = NULL;
+    checksum_copy_t copy = NULL;
+#ifdef CHECKSUM_X86
+    __builtin_cpu_init();
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    if (impl == CHECKSUM_IMPL_AUTO)
+        impl = has_avx2 ? CHECKSUM_IMPL_AVX2 : CHECKSUM_IMPL_SCALAR;
+    if (impl == CHECKSUM_IMPL_AVX2 && has_avx2)
+        add = checksum_add_avx2, copy = checksum_copy_avx2;
+#else
+    if (impl == CHECKSUM_IMPL_AUTO)
+        impl = CHECKSUM_IMPL_SCALAR;
+#endif
+    if (impl == CHECKSUM_IMPL_SCALAR)
+        add = checksum_add_scalar, copy = checksum_copy_scalar;
+    if (!add)
+        return -1;
+    checksum_add = add;
+    checksum_copy_add = copy;
+    checksum_impl = impl;
+    return 0;
+}
+
+/**
+ * @brief 获取当前使用的校验和实现
+ *
+ * @return checksum_impl_t 尚未选定时为CHECKSUM_IMPL_AUTO
+ */
+checksum_impl_t checksum_get_impl() {
+    return checksum_impl;
+}
+
+/**
+ * @brief 把未折叠的和折叠为16位反码和
+ *
+ * @param sum 未折叠的和
+ * @return uint16_t 16位反码和，未取反
+ */
+static inline uint16_t checksum_fold(uint64_t sum) {
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return sum;
+}
+
 /**
  * @brief 计算16位校验和
  *
@@ -70,27 +234,57 @@ uint8_t ip_prefix_match(uint8_t *ipa, uint8_t *ipb) {
  * @return uint16_t 校验和
  */
 uint16_t checksum16(uint16_t *data, size_t len) {
-       uint32_t sum = 0;
-    uint16_t word;
-
-    while (len > 1) {
-        memcpy(&word, data, 2);  // 安全地从 data 读两个字节
-        sum += word;
-        data = (uint16_t *)((uint8_t *)data + 2);  // 移动两个字节
-        len -= 2;
-    }
+    uint64_t sum = checksum_add((const uint8_t *)data, len & ~(size_t)1);
 
-    if (len == 1) {
-        uint8_t last_byte = *(uint8_t *)data;
+    if (len & 1) {
+        uint8_t last_byte = ((uint8_t *)data)[len - 1];
         sum += last_byte << 8;  // 最后一个字节左移，高位对齐
     }
 
-    // 折叠进位
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~checksum_fold(sum);
+}
+
+/**
+ * @brief 拷贝数据并顺带计算其16位反码和，数据只需读一遍，用于把应用层数据拷贝进发送缓冲区。
+ * 奇数长度时最后一个字节按补0处理，结果可作为buf的csum，与之后添加的偶数长度头部一起组成传输层校验和
+ *
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ * @return uint16_t 折叠后未取反的反码和
+ */
+uint16_t checksum_copy(void *dst, const void *src, size_t len) {
+    uint64_t sum = checksum_copy_add(dst, src, len & ~(size_t)1);
+    if (len & 1) {
+        uint8_t last[2] = {((const uint8_t *)src)[len - 1], 0};
+        uint16_t word;
+        ((uint8_t *)dst)[len - 1] = last[0];
+        memcpy(&word, last, 2);
+        sum += word;
     }
+    return checksum_fold(sum);
+}
 
-    return ~sum;
+/**
+ * @brief 按RFC 1624增量更新校验和：HC' = ~(~HC + ~m + m')，
+ * 报文只改动了少数字段时不必重新累加其余未变的数据
+ *
+ * @param checksum 改动前的校验和
+ * @param old_data 被改动字段的旧内容
+ * @param new_data 被改动字段的新内容
+ * @param len 字段长度，须为偶数，且字段在报文中从偶数偏移开始
+ * @return uint16_t 改动后的校验和
+ */
+uint16_t checksum16_update(uint16_t checksum, const void *old_data, const void *new_data, size_t len) {
+    uint64_t sum = (uint16_t)~checksum;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        uint16_t old_word, new_word;
+        memcpy(&old_word, (const uint8_t *)old_data + i, 2);
+        memcpy(&new_word, (const uint8_t *)new_data + i, 2);
+        sum += (uint16_t)~old_word;
+        sum += new_word;
+    }
+    return ~checksum_fold(sum);
 }
 
 #pragma pack(1)
@@ -104,81 +298,65 @@ typedef struct peso_hdr {
 #pragma pack()
 
 /**
- * @brief 计算传输层协议（如TCP/UDP）的校验和
+ * @brief 累加传输层伪头部
+ *
+ * @param protocol  传输层协议号
+ * @param len       传输层报文总长度（头部+数据）
+ * @param src_ip    源IP地址
+ * @param dst_ip    目的IP地址
+ * @return uint64_t 未折叠的和
+ */
+static uint64_t transport_pseudo_sum(uint8_t protocol, uint16_t len, uint8_t *src_ip, uint8_t *dst_ip) {
+    peso_hdr_t peso;
+    memcpy(peso.src_ip, src_ip, NET_IP_LEN);
+    memcpy(peso.dst_ip, dst_ip, NET_IP_LEN);
+    peso.placeholder = 0;
+    peso.protocol = protocol;
+    peso.total_len16 = swap16(len);
+    return checksum_add((const uint8_t *)&peso, sizeof(peso));
+}
+
+/**
+ * @brief 计算传输层协议（如TCP/UDP）的校验和。伪头部单独累加，
+ * 报文原地累加，不拷贝也不修改buf；奇数长度时最后一个字节按补0处理。
+ * buf带BUF_CSUM_PAYLOAD时直接使用拷贝负载时算出的部分和
  *
  * @param protocol  传输层协议号（如NET_PROTOCOL_UDP、NET_PROTOCOL_TCP）
- * @param buf       待计算的数据包缓冲区
+ * @param buf       待计算的数据包缓冲区，校验和字段须已置0；
+ *                  校验收到的报文时不必置0，连同校验和字段一起累加，正确时结果为0
  * @param src_ip    源IP地址
  * @param dst_ip    目的IP地址
  * @return uint16_t 计算得到的16位校验和
  */
 uint16_t transport_checksum(uint8_t protocol, buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip) {
-    // TO-DO
-    // 这边读入的是已经把首部校验和置为0的数据包
-    if (protocol == NET_PROTOCOL_UDP) {
-        int padflag = 0;
-        if(buf->len % 2) {
-            buf_add_padding(buf, 1);  // 如果buf的长度是奇数，补齐为偶数
-            padflag++;
-        }
-        // 计算udp校验和
-        // 为了加入伪头部，可以申请一个临时缓冲，把buf里的数据拷出来，再填写伪头部字段计算
-        uint8_t temp[12 + buf->len]; 
-        
-        memcpy(temp + 12, buf->data, buf->len);  // 先把数据包拷贝到临时缓冲区
-        // 伪头部的结构: | 4B src ip | 4B dest ip |0 1B|protocol 1B |UDP长度 2B|
-        
-        memcpy(temp, src_ip, 4);  // 拷贝源ip
-        memcpy(temp + 4, dst_ip, 4);  // 拷贝目的ip
-        memset(temp + 8, 0, 1);  // 填充一个字节为0
-        temp[9] = protocol;  // 填充协议号
-        memcpy(temp + 10, temp+16, 2);  // 填充udp长度  temp+16就是长度字段
-
-        // 计算校验和
-        uint16_t jyh = checksum16((uint16_t *)temp, 12 + buf->len);  // 计算校验和
-        if(padflag) {
-            buf_remove_padding(buf, 1);
-
-        }
-        return jyh;
-    } else if (protocol == NET_PROTOCOL_TCP) {
-        int padflag = 0;
-        // 1. 处理TCP头部长度和数据填充
-        // 获取TCP头部长度（HLEN，高4位，单位为4字节）
-        // uint8_t hlen = (buf->data[12] >> 4) & 0x0F;  // TCP头部前16字节中的第13字节高4位
-        uint16_t tcp_total_len = buf->len;  // 总长度 可以直接从buf的len得到
-
-        // 2. 确保总长度为偶数（头部+数据）
-        if (tcp_total_len % 2) {
-            buf_add_padding(buf, 1);  // 填充1字节0
-            padflag++;
-        }
-
-        // 3. 构造临时缓冲区（伪头部 + TCP头部 + 数据）
-        uint16_t temp_len = 12 + buf->len;  // 伪头部12字节 + TCP总长度 + 可能的1个padding
-        uint8_t temp[temp_len];
-
-        // 4. 填充伪头部
-        memcpy(temp, src_ip, 4);          // 源IP
-        memcpy(temp + 4, dst_ip, 4);      // 目的IP
-        memset(temp + 8, 0, 1);           // 保留字节置0
-        temp[9] = protocol;               // 协议号（TCP=6）
-        // 填充TCP总长度（注意：需转换为网络字节序，若原buf中长度为网络序则直接拷贝）
-        uint16_t tcp_len_net = swap16(tcp_total_len);   // 这个数据因为tcp头部不存，从buf->len获得，就需要转字节序
-        memcpy(temp + 10, &tcp_len_net, 2);           // 填充到伪头部最后2字节
-
-        // 5. 填充TCP头部和数据（头部已置0校验和，需确保校验和字段为0）
-        memcpy(temp + 12, buf->data, buf->len);  // 拷贝头部（含置0的校验和）和数据
-
-        // 6. 计算校验和
-        uint16_t jyh = checksum16((uint16_t *)temp, temp_len);
-
-        // 7. 移除填充（若有）
-        if (padflag) {
-            buf_remove_padding(buf, 1);
-        }
-
-        return jyh;
+    uint16_t len = buf->len;
+    if (protocol == NET_PROTOCOL_UDP && buf->len >= 8)
+        len = buf->data[4] << 8 | buf->data[5];  // 伪头部的UDP长度取自UDP头部
+    uint64_t sum = transport_pseudo_sum(protocol, len, src_ip, dst_ip);
+    size_t hdr_len = buf->len - buf->csum_len;
+    if ((buf->flags & BUF_CSUM_PAYLOAD) && buf->csum_len <= buf->len && !(hdr_len & 1)) {  // 负载已在拷贝时累加过，只累加头部
+        return ~checksum_fold(sum + checksum_add(buf->data, hdr_len) + buf->csum);
+    }
+    sum += checksum_add(buf->data, buf->len & ~(size_t)1);
+    if (buf->len & 1) {
+        uint8_t last[2] = {buf->data[buf->len - 1], 0};
+        uint16_t word;
+        memcpy(&word, last, 2);
+        sum += word;
     }
-    
-}
\ No newline at end of file
+    return ~checksum_fold(sum);
+}
+
+/**
+ * @brief 计算传输层伪头部的校验和（折叠后未取反），用于校验和卸载：
+ * 校验和字段填入该值后，由驱动后端从传输层头部开始累加并取反
+ *
+ * @param protocol  传输层协议号
+ * @param len       传输层报文总长度（头部+数据）
+ * @param src_ip    源IP地址
+ * @param dst_ip    目的IP地址
+ * @return uint16_t 伪头部的16位反码和
+ */
+uint16_t transport_pseudo_checksum(uint8_t protocol, uint16_t len, uint8_t *src_ip, uint8_t *dst_ip) {
+    return checksum_fold(transport_pseudo_sum(protocol, len, src_ip, dst_ip));
+}
@@ -0,0 +1,173 @@
+#include "arp.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+#include "tcp.h"
+#include "testing/log.h"
+#include "timer.h"
+
+#include <pcap.h>
+#include <string.h>
+
+extern FILE *pcap_in;
+extern FILE *pcap_out;
+extern FILE *pcap_demo;
+extern FILE *control_flow;
+extern FILE *icmp_fout;
+extern FILE *tcp_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern FILE *arp_log_f;
+
+char *print_ip(uint8_t *ip);
+char *print_mac(uint8_t *mac);
+
+uint8_t my_mac[] = NET_IF_MAC;
+uint8_t boardcast_mac[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+int check_log();
+int check_pcap();
+FILE *open_file(char *path, char *name, char *mode);
+
+void log_tab_buf();
+
+#define ARP_CACHE_TEST_HITS 4  // 回放中应命中下一跳缓存的报文数
+
+void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    if (!data)  // 发送缓冲区有了空间或连接已关闭的通知，回显的数据都已放入缓冲区
+        return;
+    for (int i = 0; i < len; i++)
+        putchar(data[i]);
+    if (len)
+        putchar('\n');
+    fflush(stdout);
+
+    tcp_send(tcp_conn, data, len, 60000, src_ip, src_port);  // 发送tcp包
+}
+
+/**
+ * @brief 检查tcp连接的下一跳mac缓存：回放中对端的mac地址先是a开头的数据使用的，改变之后是b开头的数据使用的。
+ * 期望建立连接时填入缓存、之后命中；进入刷新窗口时缓存失效、单播探测；对端的mac地址改变后重新解析
+ *
+ * @param path 数据目录
+ * @return int 不符合的检查数，出错为-1
+ */
+static int check_cache(char *path) {
+    const arp_stats_t *stats = arp_get_stats();
+    int err = 0;
+    if (stats->cache_hits != ARP_CACHE_TEST_HITS || stats->refresh_probes != 1) {
+        PRINT_ERROR("cache_hits=%llu refresh_probes=%llu, expected %d and 1\n", (unsigned long long)stats->cache_hits, (unsigned long long)stats->refresh_probes, ARP_CACHE_TEST_HITS);
+        err++;
+    }
+
+    char errbuf[PCAP_ERRBUF_SIZE];
+    FILE *f = open_file(path, "out.pcap", "r");
+    pcap_t *pcap = f ? pcap_fopen_offline(f, errbuf) : NULL;
+    if (!pcap) {
+        PRINT_ERROR("Failed to open out.pcap\n");
+        return -1;
+    }
+    uint8_t old_mac[NET_MAC_LEN] = {0x21, 0x32, 0x43, 0x54, 0x65, 0x06};
+    uint8_t new_mac[NET_MAC_LEN] = {0x02, 0xaa, 0xbb, 0xcc, 0xdd, 0xee};
+    int idx = 0;
+    struct pcap_pkthdr *hdr;
+    const uint8_t *data;
+    while (pcap_next_ex(pcap, &hdr, &data) == 1) {
+        idx++;
+        ether_hdr_t *ether = (ether_hdr_t *)data;
+        if (hdr->len <= sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof(tcp_hdr_t) || swap16(ether->protocol16) != NET_PROTOCOL_IP)
+            continue;
+        ip_hdr_t *ip_hdr = (ip_hdr_t *)(data + sizeof(ether_hdr_t));
+        if (swap16(ip_hdr->total_len16) == sizeof(ip_hdr_t) + sizeof(tcp_hdr_t))
+            continue;
+        uint8_t c = data[sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof(tcp_hdr_t)];
+        if (memcmp(ether->dst, c == 'b' ? new_mac : old_mac, NET_MAC_LEN)) {
+            PRINT_ERROR("Packet %d: '%c' segment sent to %s\n", idx, c, print_mac(ether->dst));
+            err++;
+        }
+    }
+    pcap_close(pcap);
+    if (!err)
+        PRINT_PASS("====> Next hop cache hits, refreshes and invalidations as expected.\n");
+    return err;
+}
+
+buf_t buf;
+int main(int argc, char *argv[]) {
+    int ret;
+    PRINT_INFO("Test begin.\n");
+    pcap_in = open_file(argv[1], "in.pcap", "r");
+    pcap_out = open_file(argv[1], "out.pcap", "w");
+    control_flow = open_file(argv[1], "log", "w");
+    if (pcap_in == 0 || pcap_out == 0 || control_flow == 0) {
+        if (pcap_in)
+            fclose(pcap_in);
+        else
+            PRINT_ERROR("Failed to open in.pcap\n");
+        if (pcap_out)
+            fclose(pcap_out);
+        else
+            PRINT_ERROR("Failed to open out.pcap\n");
+        if (control_flow)
+            fclose(control_flow);
+        else
+            PRINT_ERROR("Failed to open log\n");
+        return -1;
+    }
+    icmp_fout = control_flow;
+    tcp_fout = control_flow;
+    arp_log_f = control_flow;
+
+    net_init();
+    tcp_open(60000, tcp_handler);  // 注册端口的tcp监听回调
+    log_tab_buf();
+    int i = 1;
+    PRINT_INFO("Feeding input %02d", i);
+    while ((ret = driver_recv(&buf)) > 0) {
+        printf("\b\b%02d", i);
+        fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        timer_poll();  // 虚拟时钟已推进到本帧的抓包时间，先处理其间到期的定时器
+        ethernet_in(&buf);
+        log_tab_buf();
+    }
+    if (ret < 0) {
+        PRINT_WARN("\nError occur on loading input,exiting\n");
+    }
+    driver_close();
+    PRINT_INFO("\nSample input all processed, checking output\n");
+
+    fclose(control_flow);
+
+    demo_log = open_file(argv[1], "demo_log", "r");
+    out_log = open_file(argv[1], "log", "r");
+    pcap_out = open_file(argv[1], "out.pcap", "r");
+    pcap_demo = open_file(argv[1], "demo_out.pcap", "r");
+    if (demo_log == 0 || out_log == 0 || pcap_out == 0 || pcap_demo == 0) {
+        if (demo_log)
+            fclose(demo_log);
+        else
+            PRINT_ERROR("Failed to open demo_log\n");
+        if (out_log)
+            fclose(out_log);
+        else
+            PRINT_ERROR("Failed to open log\n");
+        if (pcap_demo)
+            fclose(pcap_demo);
+        else
+            PRINT_ERROR("Failed to open demo_out.pcap\n");
+        if (pcap_out)
+            fclose(pcap_out);
+        else
+            PRINT_ERROR("Failed to open out.pcap\n");
+        return -1;
+    }
+    check_log();
+    ret = check_pcap() ? 1 : 0;
+    if (check_cache(argv[1]))
+        ret = 1;
+    PRINT_WARN("For this test, log is only a reference. \
+Your implementation is OK if your pcap file is the same to the demo pcap file.\n");
+    fclose(demo_log);
+    fclose(out_log);
+    return ret ? -1 : 0;
+}
\ No newline at end of file
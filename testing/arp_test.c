@@ -3,6 +3,7 @@
 #include "ethernet.h"
 #include "net.h"
 #include "testing/log.h"
+#include "timer.h"
 
 #include <string.h>
 
@@ -59,6 +60,7 @@ int main(int argc, char *argv[]) {
     while ((ret = driver_recv(&buf)) > 0) {
         printf("\b\b%02d", i);
         fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        timer_poll();  // 虚拟时钟已推进到本帧的抓包时间，先处理其间到期的定时器
         if (memcmp(buf.data, my_mac, 6) && memcmp(buf.data, boardcast_mac, 6)) {
             buf_t buf2;
             buf_copy(&buf2, &buf, 0);
@@ -67,6 +69,7 @@ int main(int argc, char *argv[]) {
             uint8_t *ip = buf.data + 30;
             // net_protocol_t pro = buf.data[13] ? NET_PROTOCOL_ARP : NET_PROTOCOL_IP;
             arp_out(&buf2, ip);
+            buf_unref(&buf2);
         } else {
             ethernet_in(&buf);
         }
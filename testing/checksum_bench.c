@@ -0,0 +1,141 @@
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * 校验和微基准：校验各实现与逐字累加的原始实现结果一致，
+ * 再比较它们在64B、1500B和64KB报文上的吞吐量，以及先拷贝再累加与拷贝时顺带累加（checksum_copy）的吞吐量。
+ * 用法：./checksum_bench [每种长度处理的总字节数，默认1GB]
+ */
+
+#define BENCH_MAX_LEN (64 * 1024)
+
+static const struct {
+    checksum_impl_t impl;
+    const char *name;
+} impls[] = {
+    {CHECKSUM_IMPL_SCALAR, "scalar"},
+    {CHECKSUM_IMPL_AVX2, "avx2"},
+};
+
+static const size_t lens[] = {64, 1500, BENCH_MAX_LEN};
+
+/**
+ * @brief 原始实现，每次折叠一个16位字，作为对照
+ *
+ */
+__attribute__((noinline)) static uint16_t checksum16_reference(const uint8_t *data, size_t len) {
+    uint32_t sum = 0;
+    uint16_t word;
+    for (; len > 1; data += 2, len -= 2) {
+        memcpy(&word, data, 2);
+        sum += word;
+    }
+    if (len == 1)
+        sum += *data << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+static double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t total = argc > 1 ? strtoull(argv[1], NULL, 0) : (size_t)1 << 30;
+    static uint8_t data[BENCH_MAX_LEN + 64];
+    srand(1);
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = rand();
+
+    for (size_t j = 0; j < sizeof(lens) / sizeof(lens[0]); j++) {
+        size_t rounds = total / lens[j];
+        volatile uint16_t sink = 0;
+        double start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            __asm__ volatile("" : : "r"(data) : "memory");  // 阻止编译器把循环不变的计算提出循环
+            sink += checksum16_reference(data, lens[j]);
+        }
+        double elapsed = bench_now() - start;
+        printf("%-8s %6zu B  %8.2f GB/s  %7.1f ns/op\n", "original", lens[j],
+               rounds * lens[j] / elapsed / 1e9, elapsed / rounds * 1e9);
+        (void)sink;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (checksum_select(impls[i].impl) < 0) {
+            printf("%-8s not supported\n", impls[i].name);
+            continue;
+        }
+        // 所有长度、奇偶和不对齐的起始地址都要与原始实现一致
+        for (size_t off = 0; off < 4; off++)
+            for (size_t len = 0; len <= 4096 + 33; len++)
+                if (checksum16((uint16_t *)(data + off), len) != checksum16_reference(data + off, len)) {
+                    printf("%-8s mismatch at offset %zu len %zu\n", impls[i].name, off, len);
+                    ret = 1;
+                    goto next;
+                }
+        uint8_t ones[BENCH_MAX_LEN];  // 全0xFF时进位最多
+        memset(ones, 0xFF, sizeof(ones));
+        if (checksum16((uint16_t *)ones, sizeof(ones)) != checksum16_reference(ones, sizeof(ones))) {
+            printf("%-8s mismatch on all-ones input\n", impls[i].name);
+            ret = 1;
+            goto next;
+        }
+        // 拷贝时顺带累加的结果与拷贝后补0再累加一致，且拷贝正确
+        static uint8_t dst[BENCH_MAX_LEN + 64];
+        for (size_t off = 0; off < 4; off++)
+            for (size_t len = 0; len <= 4096 + 33; len++) {
+                memset(dst, 0, off + len + 2);
+                uint16_t sum = checksum_copy(dst + off, data + off, len);
+                if (memcmp(dst + off, data + off, len) || (uint16_t)~sum != checksum16_reference(dst + off, len + (len & 1))) {
+                    printf("%-8s checksum_copy mismatch at offset %zu len %zu\n", impls[i].name, off, len);
+                    ret = 1;
+                    goto next;
+                }
+            }
+
+        for (size_t j = 0; j < sizeof(lens) / sizeof(lens[0]); j++) {
+            size_t rounds = total / lens[j];
+            volatile uint16_t sink = 0;
+            double start = bench_now();
+            for (size_t r = 0; r < rounds; r++) {
+                __asm__ volatile("" : : "r"(data) : "memory");
+                sink += checksum16((uint16_t *)data, lens[j]);
+            }
+            double elapsed = bench_now() - start;
+            printf("%-8s %6zu B  %8.2f GB/s  %7.1f ns/op\n", impls[i].name, lens[j],
+                   rounds * lens[j] / elapsed / 1e9, elapsed / rounds * 1e9);
+            (void)sink;
+        }
+        for (size_t j = 0; j < sizeof(lens) / sizeof(lens[0]); j++) {
+            size_t rounds = total / lens[j];
+            volatile uint16_t sink = 0;
+            double start = bench_now();
+            for (size_t r = 0; r < rounds; r++) {
+                __asm__ volatile("" : : "r"(data), "r"(dst) : "memory");
+                memcpy(dst, data, lens[j]);
+                sink += checksum16((uint16_t *)dst, lens[j]);
+            }
+            double separate = bench_now() - start;
+            start = bench_now();
+            for (size_t r = 0; r < rounds; r++) {
+                __asm__ volatile("" : : "r"(data), "r"(dst) : "memory");
+                sink += checksum_copy(dst, data, lens[j]);
+            }
+            double fused = bench_now() - start;
+            printf("%-8s %6zu B  copy+sum %8.2f GB/s  fused %8.2f GB/s\n", impls[i].name, lens[j],
+                   rounds * lens[j] / separate / 1e9, rounds * lens[j] / fused / 1e9);
+            (void)sink;
+        }
+    next:;
+    }
+    return ret;
+}
@@ -52,6 +52,7 @@ int main(int argc, char *argv[]) {
         proto <<= 8;
         proto |= buf2.data[13];
         ethernet_out(&buf, buf2.data, proto);
+        buf_unref(&buf2);
     }
     if (ret < 0) {
         PRINT_WARN("\nError occur on loading input,exiting\n");
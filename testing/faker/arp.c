@@ -1,3 +1,4 @@
+#include "arp.h"
 #include "net.h"
 
 #include <stdio.h>
@@ -35,8 +36,16 @@ void arp_out(buf_t *buf, uint8_t *ip) {
     fprint_buf(arp_fout, buf);
 }
 
+void arp_out_cached(buf_t *buf, uint8_t *ip, arp_cache_t *cache) {
+    arp_out(buf, ip);
+}
+
 void arp_init() {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, NULL, buf_copy);
+    map_init(&arp_table, NET_IP_LEN, sizeof(arp_entry_t), 0, ARP_TIMEOUT_SEC, NULL, NULL, NULL, NULL, NULL);
+    map_init(&arp_buf, NET_IP_LEN, sizeof(arp_pending_t), 0, ARP_MIN_INTERVAL, NULL, NULL, NULL, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
-}
\ No newline at end of file
+}
+
+int arp_save(const char *path) {
+    return 0;
+}
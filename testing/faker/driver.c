@@ -1,5 +1,7 @@
 #include "buf.h"
 #include "config.h"
+#include "driver.h"
+#include "net.h"
 
 #include <pcap.h>
 #include <string.h>
@@ -11,6 +13,8 @@ static char pcap_errbuf[PCAP_ERRBUF_SIZE];
 extern FILE *pcap_in;
 extern FILE *pcap_out;
 extern FILE *control_flow;
+time_t test_clock();
+void test_clock_follow(time_t capture_ms);
 
 #ifdef _WIN32
 #include <tchar.h>
@@ -51,6 +55,7 @@ int driver_open() {
         return -1;
     }
 
+    net_set_clock(test_clock);  // 回放时使用虚拟时钟
     fprintf(control_flow, "driver opened\n");
     return 0;
 }
@@ -63,6 +68,7 @@ int driver_recv(buf_t *buf) {
         // printf("meet end of file\n");
         return 0;
     } else if (ret == 1) {
+        test_clock_follow((time_t)pkt_hdr->ts.tv_sec * 1000 + pkt_hdr->ts.tv_usec / 1000);
         buf_init(buf, pkt_hdr->len);
         memcpy(buf->data, pkt_data, pkt_hdr->len);
         return pkt_hdr->len;
@@ -72,7 +78,30 @@ int driver_recv(buf_t *buf) {
     }
 }
 
+static buf_t rx_buf;
+
+int driver_recv_batch(driver_handler_t handler, int max) {
+    struct pcap_pkthdr *pkt_hdr;
+    const uint8_t *pkt_data;
+    if (max <= 0)
+        return 0;
+    int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
+    if (ret == PCAP_ERROR_BREAK) {
+        return 0;
+    } else if (ret == 1) {
+        test_clock_follow((time_t)pkt_hdr->ts.tv_sec * 1000 + pkt_hdr->ts.tv_usec / 1000);
+        buf_borrow(&rx_buf, (uint8_t *)pkt_data, pkt_hdr->len);
+        handler(&rx_buf);
+        return 1;
+    } else {
+        fprintf(stderr, "Error in driver_recv_batch: %s\n", pcap_geterr(pcap));
+        return -1;
+    }
+}
+
 int driver_send(buf_t *buf) {
+    if (buf_linearize(buf) < 0)
+        return -1;
     struct pcap_pkthdr header;
     memset(&header.ts, 0, sizeof(header.ts));
     header.caplen = buf->len;
@@ -81,6 +110,18 @@ int driver_send(buf_t *buf) {
     return 0;
 }
 
+int driver_flush() {
+    return 0;
+}
+
+int driver_offload() {
+    return 0;
+}
+
+int driver_fd() {
+    return -1;
+}
+
 void driver_close() {
     fprintf(control_flow, "\ndriver closed\n");
     pcap_dump_close(pdump);
@@ -1,3 +1,4 @@
+#include "ip.h"
 #include "net.h"
 
 #include <stdio.h>
@@ -35,6 +36,14 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
     fprint_buf(ip_fout, buf);
 }
 
+void ip_out_cached(buf_t *buf, uint8_t *ip, net_protocol_t protocol, arp_cache_t *cache) {
+    ip_out(buf, ip, protocol);
+}
+
 void ip_init() {
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
-}
\ No newline at end of file
+}
+
+uint16_t ip_pmtu(const uint8_t *dst_ip) {
+    return net_if_mtu;
+}
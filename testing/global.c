@@ -2,6 +2,7 @@
 #include "ip.h"
 #include "tcp.h"
 #include "map.h"
+#include "net.h"
 #include "testing/log.h"
 #include "utils.h"
 
@@ -57,6 +58,38 @@ extern map_t arp_buf;
 //         "unknown"
 // };
 
+/**
+ * @brief 测试使用的虚拟时钟，只在test_clock_advance时前进，使超时相关的行为可以确定地重放
+ *
+ */
+static time_t test_clock_ms;
+
+time_t test_clock() {
+    return test_clock_ms;
+}
+
+void test_clock_advance(time_t ms) {
+    test_clock_ms += ms;
+    net_clock_update();
+}
+
+/**
+ * @brief 按输入抓包的时间戳推进虚拟时钟，以第一帧为0时刻，只进不退。
+ * 时间戳全相同或乱序的旧抓包因此不会推进时钟，定时相关的测试用间隔合适的时间戳构造输入
+ *
+ * @param capture_ms 当前帧的抓包时间（毫秒）
+ */
+void test_clock_follow(time_t capture_ms) {
+    static int started;
+    static time_t first_ms;
+    if (!started) {
+        started = 1;
+        first_ms = capture_ms;
+    }
+    if (capture_ms - first_ms > test_clock_ms)
+        test_clock_advance(capture_ms - first_ms - test_clock_ms);
+}
+
 FILE *open_file(char *path, char *name, char *mode) {
     char filename[128];
     sprintf(filename, "%s/%s", path, name);
@@ -133,41 +166,38 @@ void fprint_buf(FILE *f, buf_t *buf) {
         for (int i = 0; i < buf->len; i++) {
             fprintf(f, " %02x", buf->data[i]);
         }
+        for (int i = 0; i < buf->slice_len; i++) {
+            fprintf(f, " %02x", buf->slice[i]);
+        }
         fprintf(f, "\n");
     }
 }
 
-static inline void *map_entry_get(map_t *map, size_t pos) {
-    if (pos >= map->max_size)
-        return NULL;
-    return map->data + pos * (map->key_len + map->value_len + sizeof(time_t));
+static void log_tab_entry(void *ip, void *mac, time_t *timestamp) {
+    fprintf(arp_log_f, "%s -> %s\n", print_ip(ip), print_mac(mac));
 }
 
-static inline int map_entry_valid(map_t *map, const void *entry) {
-    time_t entry_time = *(time_t *)((uint8_t *)entry + map->key_len + map->value_len);
-    return entry_time && (!map->timeout || entry_time + map->timeout >= time(NULL));
+static void log_buf_entry(void *ip, void *value, time_t *timestamp) {
+    arp_pending_t *pending = value;
+    for (int n = 0; n < pending->count; n++) {  // 排队的每个数据包占一行
+        buf_t *buf = &pending->bufs[(pending->head + n) % ARP_PENDING_MAX];
+        fprintf(arp_log_f, "%s -> ", print_ip(ip));
+        for (int i = 0; i < buf->len; i++) {
+            fprintf(arp_log_f, " %02x", buf->data[i]);
+        }
+        for (int i = 0; i < buf->slice_len; i++) {
+            fprintf(arp_log_f, " %02x", buf->slice[i]);
+        }
+        fputc('\n', arp_log_f);
+    }
 }
 
 void log_tab_buf() {
     fprintf(arp_log_f, "<====== arp table =======>\n");
-    for (size_t i = 0; i < arp_table.max_size; i++) {
-        uint8_t *entry = (uint8_t *)map_entry_get(&arp_table, i);
-        if (map_entry_valid(&arp_table, entry))
-            fprintf(arp_log_f, "%s -> %s\n", print_ip(entry), print_mac(entry + arp_table.key_len));
-    }
+    map_foreach(&arp_table, log_tab_entry);
 
     fprintf(arp_log_f, "<====== arp buf =======>\n");
-    for (size_t i = 0; i < arp_buf.max_size; i++) {
-        uint8_t *entry = (uint8_t *)map_entry_get(&arp_buf, i);
-        if (map_entry_valid(&arp_buf, entry)) {
-            fprintf(arp_log_f, "%s -> ", print_ip(entry));
-            buf_t *buf = (buf_t *)(entry + arp_buf.key_len);
-            for (int i = 0; i < buf->len; i++) {
-                fprintf(arp_log_f, " %02x", buf->data[i]);
-            }
-            fputc('\n', arp_log_f);
-        }
-    }
+    map_foreach(&arp_buf, log_buf_entry);
 }
 
 int get_round(FILE *f) {
@@ -70,6 +70,7 @@ int main(int argc, char *argv[]) {
             memset(buf2.data, 0, sizeof(len));
             buf_remove_header(&buf2, len);
             ip_out(&buf2, ip, pro);
+            buf_unref(&buf2);
         } else {
             ethernet_in(&buf);
         }
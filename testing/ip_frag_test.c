@@ -22,15 +22,17 @@ int main(int argc, char *argv[]) {
         return -1;
     }
     arp_fout = control_flow;
-    uint8_t *p = buf.payload + 1000;
-    buf.data = p;
-    buf.len = 0;
+    static uint8_t input[UINT16_MAX];
+    uint8_t *p = input;
+    size_t len = 0;
     char c;
     while (fread(&c, 1, 1, in)) {
         *p = c;
         p++;
-        buf.len++;
+        len++;
     }
+    buf_init(&buf, len);
+    memcpy(buf.data, input, len);
     PRINT_INFO("Feeding input.\n");
     ip_out(&buf, net_if_ip, NET_PROTOCOL_TCP);
 
@@ -3,6 +3,7 @@
 #include "ethernet.h"
 #include "ip.h"
 #include "testing/log.h"
+#include "timer.h"
 
 #include <string.h>
 
@@ -62,6 +63,7 @@ int main(int argc, char *argv[]) {
         printf("\b\b%02d", i);
         // printf("\nFeeding input %02d\n",i);
         fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        timer_poll();  // 虚拟时钟已推进到本帧的抓包时间，先处理其间到期的定时器
         if (memcmp(buf.data, my_mac, 6) && memcmp(buf.data, boardcast_mac, 6)) {
             buf_t buf2;
             buf_copy(&buf2, &buf, 0);
@@ -74,6 +76,7 @@ int main(int argc, char *argv[]) {
             buf_remove_header(&buf2, len);
             // printf("ip_out: hd_len:%d\tip:%s\tpro:%d\n",len,print_ip(ip),pro);
             ip_out(&buf2, ip, pro);
+            buf_unref(&buf2);
         } else {
             ethernet_in(&buf);
         }
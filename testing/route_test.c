@@ -0,0 +1,234 @@
+#include "arp.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+#include "route.h"
+#include "udp.h"
+#include "testing/log.h"
+
+#include <string.h>
+
+extern FILE *pcap_in;
+extern FILE *pcap_out;
+extern FILE *pcap_demo;
+extern FILE *control_flow;
+extern FILE *icmp_fout;
+extern FILE *tcp_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern FILE *arp_log_f;
+
+char *print_ip(uint8_t *ip);
+char *print_mac(uint8_t *mac);
+
+uint8_t my_mac[] = NET_IF_MAC;
+uint8_t boardcast_mac[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+int check_log();
+int check_pcap();
+FILE *open_file(char *path, char *name, char *mode);
+
+void log_tab_buf();
+
+void udp_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    printf("recv udp packet from %s:%u len=%zu\n", iptos(src_ip), src_port, len);
+    for (int i = 0; i < len; i++)
+        putchar(data[i]);
+    putchar('\n');
+    udp_send(data, len, 60000, src_ip, src_port);  // 发送udp包
+}
+
+/**
+ * @brief 检查一次路由查找的结果
+ *
+ * @param dst 目的地址
+ * @param expected 期望的下一跳
+ * @return int 相符为0，否则为1
+ */
+static int route_expect(const char *dst, const char *expected) {
+    uint8_t dst_ip[NET_IP_LEN], next_hop[NET_IP_LEN];
+    sscanf(dst, "%hhu.%hhu.%hhu.%hhu", &dst_ip[0], &dst_ip[1], &dst_ip[2], &dst_ip[3]);
+    sscanf(expected, "%hhu.%hhu.%hhu.%hhu", &next_hop[0], &next_hop[1], &next_hop[2], &next_hop[3]);
+    const uint8_t *got = route_lookup(dst_ip);
+    if (!memcmp(got, next_hop, NET_IP_LEN))
+        return 0;
+    PRINT_ERROR("route_lookup(%s) = %s, expected %s\n", dst, iptos((uint8_t *)got), expected);
+    return 1;
+}
+
+/**
+ * @brief 添加一条路由，地址都以点分十进制给出
+ *
+ * @return int route_add的返回值
+ */
+static int route_add_str(const char *prefix, uint8_t prefix_len, const char *gateway) {
+    uint8_t p[NET_IP_LEN], g[NET_IP_LEN];
+    sscanf(prefix, "%hhu.%hhu.%hhu.%hhu", &p[0], &p[1], &p[2], &p[3]);
+    sscanf(gateway, "%hhu.%hhu.%hhu.%hhu", &g[0], &g[1], &g[2], &g[3]);
+    return route_add(p, prefix_len, g);
+}
+
+/**
+ * @brief 不经过网卡直接检查路由表：最长前缀匹配、删除与替换、下一跳缓存随版本失效、前缀树节点用尽时的回滚
+ *
+ * @return int 出错的检查数
+ */
+static int route_check() {
+    int err = 0;
+    uint8_t prefix[NET_IP_LEN];
+
+    // 只有网卡所在子网的直连路由，其他地址也按直连处理
+    err += route_expect("192.168.163.10", "192.168.163.10");
+    err += route_expect("10.0.0.5", "10.0.0.5");
+
+    // 重叠的前缀，最长的匹配优先
+    err += route_add_str("0.0.0.0", 0, "192.168.163.1");
+    err += route_add_str("10.0.0.0", 8, "192.168.163.2");
+    err += route_add_str("10.1.0.0", 16, "192.168.163.3");
+    err += route_add_str("10.1.2.0", 24, "192.168.163.4");
+    err += route_add_str("10.1.2.3", 32, "192.168.163.5");
+    err += route_add_str("172.16.0.0", 12, "192.168.163.6");
+    err += route_expect("8.8.8.8", "192.168.163.1");
+    err += route_expect("10.9.9.9", "192.168.163.2");
+    err += route_expect("10.1.9.9", "192.168.163.3");
+    err += route_expect("10.1.2.9", "192.168.163.4");
+    err += route_expect("10.1.2.3", "192.168.163.5");
+    err += route_expect("172.31.255.1", "192.168.163.6");
+    err += route_expect("172.32.0.1", "192.168.163.1");
+    err += route_expect("192.168.163.10", "192.168.163.10");  // 直连子网比默认路由长
+
+    // 重复查找命中缓存；删除路由后缓存失效，查到更短的前缀
+    err += route_expect("10.1.2.9", "192.168.163.4");
+    uint64_t hits = route_get_stats()->cache_hits;
+    err += route_expect("10.1.2.9", "192.168.163.4");
+    if (route_get_stats()->cache_hits != hits + 1) {
+        PRINT_ERROR("route_lookup did not hit the next hop cache\n");
+        err++;
+    }
+    uint32_t generation = route_get_stats()->generation;
+    memcpy(prefix, (uint8_t[]){10, 1, 2, 0}, NET_IP_LEN);
+    err += route_delete(prefix, 24) != 0;
+    err += route_delete(prefix, 24) != -1;
+    if (route_get_stats()->generation == generation) {
+        PRINT_ERROR("route_delete did not bump the generation\n");
+        err++;
+    }
+    err += route_expect("10.1.2.9", "192.168.163.3");
+    err += route_expect("10.1.2.3", "192.168.163.5");
+
+    // 替换已有的路由
+    err += route_add_str("10.0.0.0", 8, "192.168.163.7");
+    err += route_expect("10.9.9.9", "192.168.163.7");
+
+    // 不断添加首字节不同的/32路由，直到前缀树节点用尽：失败的路由不留在表中，已有的路由不受影响
+    int added = 0;
+    for (int i = 20; i < 20 + ROUTE_MAX_ENTRIES; i++) {
+        char dst[16];
+        snprintf(dst, sizeof(dst), "%d.0.0.1", i);
+        if (route_add_str(dst, 32, "192.168.163.8") < 0) {
+            err += route_expect(dst, "192.168.163.1");
+            memcpy(prefix, (uint8_t[]){i, 0, 0, 1}, NET_IP_LEN);
+            err += route_delete(prefix, 32) != -1;
+            break;
+        }
+        added++;
+    }
+    if (added == ROUTE_MAX_ENTRIES) {
+        PRINT_ERROR("route_add never ran out of trie nodes\n");
+        err++;
+    }
+    err += route_expect("20.0.0.1", "192.168.163.8");
+    err += route_expect("10.1.2.3", "192.168.163.5");
+    err += route_expect("172.31.255.1", "192.168.163.6");
+    return err;
+}
+
+buf_t buf;
+int main(int argc, char *argv[]) {
+    int ret;
+    PRINT_INFO("Test begin.\n");
+    pcap_in = open_file(argv[1], "in.pcap", "r");
+    pcap_out = open_file(argv[1], "out.pcap", "w");
+    control_flow = open_file(argv[1], "log", "w");
+    if (pcap_in == 0 || pcap_out == 0 || control_flow == 0) {
+        if (pcap_in)
+            fclose(pcap_in);
+        else
+            PRINT_ERROR("Failed to open in.pcap\n");
+        if (pcap_out)
+            fclose(pcap_out);
+        else
+            PRINT_ERROR("Failed to open out.pcap\n");
+        if (control_flow)
+            fclose(control_flow);
+        else
+            PRINT_ERROR("Failed to open log\n");
+        return -1;
+    }
+    icmp_fout = control_flow;
+    tcp_fout = control_flow;
+    arp_log_f = control_flow;
+
+    net_init();
+    if (route_check()) {
+        PRINT_ERROR("Routing table check failed\n");
+        fclose(pcap_in);
+        fclose(pcap_out);
+        fclose(control_flow);
+        return -1;
+    }
+    PRINT_PASS("Routing table check passed\n");
+
+    // 回放：经网关发往其他网段，直连子网中的地址仍直接解析
+    route_init();
+    uint8_t any[NET_IP_LEN] = {0}, gateway[NET_IP_LEN] = {192, 168, 163, 1};
+    route_add(any, 0, gateway);
+    udp_open(60000, udp_handler);  // 注册端口的udp监听回调
+    log_tab_buf();
+    int i = 1;
+    PRINT_INFO("Feeding input %02d", i);
+    while ((ret = driver_recv(&buf)) > 0) {
+        printf("\b\b%02d", i);
+        fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        ethernet_in(&buf);
+        log_tab_buf();
+    }
+    if (ret < 0) {
+        PRINT_WARN("\nError occur on loading input,exiting\n");
+    }
+    driver_close();
+    PRINT_INFO("\nSample input all processed, checking output\n");
+
+    fclose(control_flow);
+
+    demo_log = open_file(argv[1], "demo_log", "r");
+    out_log = open_file(argv[1], "log", "r");
+    pcap_out = open_file(argv[1], "out.pcap", "r");
+    pcap_demo = open_file(argv[1], "demo_out.pcap", "r");
+    if (demo_log == 0 || out_log == 0 || pcap_out == 0 || pcap_demo == 0) {
+        if (demo_log)
+            fclose(demo_log);
+        else
+            PRINT_ERROR("Failed to open demo_log\n");
+        if (out_log)
+            fclose(out_log);
+        else
+            PRINT_ERROR("Failed to open log\n");
+        if (pcap_demo)
+            fclose(pcap_demo);
+        else
+            PRINT_ERROR("Failed to open demo_out.pcap\n");
+        if (pcap_out)
+            fclose(pcap_out);
+        else
+            PRINT_ERROR("Failed to open out.pcap\n");
+        return -1;
+    }
+    check_log();
+    ret = check_pcap() ? 1 : 0;
+    PRINT_WARN("For this test, log is only a reference. \
+Your implementation is OK if your pcap file is the same to the demo pcap file.\n");
+    fclose(demo_log);
+    fclose(out_log);
+    return ret ? -1 : 0;
+}
\ No newline at end of file
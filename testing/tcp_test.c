@@ -4,6 +4,7 @@
 #include "ip.h"
 #include "tcp.h"
 #include "testing/log.h"
+#include "timer.h"
 
 #include <string.h>
 
@@ -30,6 +31,8 @@ FILE *open_file(char *path, char *name, char *mode);
 void log_tab_buf();
 
 void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    if (!data)  // 发送缓冲区有了空间或连接已关闭的通知，回显的数据都已放入缓冲区
+        return;
     for (int i = 0; i < len; i++)
         putchar(data[i]);
     if (len)
@@ -73,6 +76,7 @@ int main(int argc, char *argv[]) {
     while ((ret = driver_recv(&buf)) > 0) {
         printf("\b\b%02d", i);
         fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        timer_poll();  // 虚拟时钟已推进到本帧的抓包时间，先处理其间到期的定时器
         ethernet_in(&buf);
         log_tab_buf();
     }